@@ -12,8 +12,6 @@
 #include "examples/rtc_gw/audio_device_module.h"
 #include "rtc_base/checks.h"
 #include "rtc_base/logging.h"
-#include "rtc_base/platform_thread.h"
-#include "system_wrappers/include/sleep.h"
 
 namespace rtcgw {
 
@@ -27,7 +25,10 @@ const size_t kRecordingBufferSize =
     kRecordingFixedSampleRate / 100 * kRecordingNumChannels * 2;
 
 FileAudioDevice::FileAudioDevice(const char* inputFilename,
-                                 const char* outputFilename)
+                                 const char* outputFilename,
+                                 MediaClock* clock,
+                                 AudioSourceCache* sources,
+                                 AudioWriterThread* writers)
     : _ptrAudioBuffer(NULL),
       _recordingBuffer(NULL),
       _playoutBuffer(NULL),
@@ -36,21 +37,24 @@ FileAudioDevice::FileAudioDevice(const char* inputFilename,
       _recordingBufferSizeIn10MS(0),
       _recordingFramesIn10MS(0),
       _playoutFramesIn10MS(0),
+      _clock(clock),
+      _sources(sources),
+      _inputSource(NULL),
+      _inputOffset(0),
       _playing(false),
       _recording(false),
-      _lastCallPlayoutMillis(0),
-      _lastCallRecordMillis(0),
-      _outputFile(*webrtc::FileWrapper::Create()),
-      _inputFile(*webrtc::FileWrapper::Create()),
+      _writers(writers),
+      _outputWriter(NULL),
       _outputFilename(outputFilename),
       _inputFilename(inputFilename) {
-      Audio_device_buffer_ = new webrtc::AudioDeviceBuffer();
-      AttachAudioBuffer(Audio_device_buffer_);
+      Audio_device_buffer_.reset(new webrtc::AudioDeviceBuffer());
+      AttachAudioBuffer(Audio_device_buffer_.get());
 }
 
 FileAudioDevice::~FileAudioDevice() {
-  delete &_outputFile;
-  delete &_inputFile;
+  // The clock ticks use the buffers and the files.
+  StopPlayout();
+  StopRecording();
 }
 
 int32_t FileAudioDevice::ActiveAudioLayer(
@@ -203,31 +207,32 @@ int32_t FileAudioDevice::StartPlayout() {
     return 0;
   }
 
-  _playing = true;
   _playoutFramesLeft = 0;
 
   if (!_playoutBuffer) {
     _playoutBuffer = new int8_t[kPlayoutBufferSize];
   }
   if (!_playoutBuffer) {
-    _playing = false;
     return -1;
   }
 
   // PLAYOUT
-  if (!_outputFilename.empty() &&
-      !_outputFile.OpenFile(_outputFilename.c_str(), false)) {
-    RTC_LOG(LS_ERROR) << "Failed to open playout file: " << _outputFilename;
-    _playing = false;
-    delete[] _playoutBuffer;
-    _playoutBuffer = NULL;
-    return -1;
+  if (!_outputFilename.empty()) {
+    _outputWriter = _writers->Open(_outputFilename);
+    if (!_outputWriter) {
+      RTC_LOG(LS_ERROR) << "Failed to open playout file: " << _outputFilename;
+      delete[] _playoutBuffer;
+      _playoutBuffer = NULL;
+      return -1;
+    }
   }
 
-  _ptrThreadPlay.reset(new rtc::PlatformThread(
-      PlayThreadFunc, this, "webrtc_audio_module_play_thread"));
-  _ptrThreadPlay->Start();
-  _ptrThreadPlay->SetPriority(rtc::kRealtimePriority);
+  // Only once ready, the clock may already tick the recording.
+  {
+    rtc::CritScope lock(&_critSect);
+    _playing = true;
+  }
+  _clock->AddClient(this);
 
   RTC_LOG(LS_INFO) << "Started playout capture to output file: "
                    << _outputFilename;
@@ -240,18 +245,22 @@ int32_t FileAudioDevice::StopPlayout() {
     _playing = false;
   }
 
-  // stop playout thread first
-  if (_ptrThreadPlay) {
-    _ptrThreadPlay->Stop();
-    _ptrThreadPlay.reset();
-  }
-
-  rtc::CritScope lock(&_critSect);
+  // Out of the clock first, back in if still recording.
+  _clock->RemoveClient(this);
+  {
+    rtc::CritScope lock(&_critSect);
 
-  _playoutFramesLeft = 0;
-  delete[] _playoutBuffer;
-  _playoutBuffer = NULL;
-  _outputFile.CloseFile();
+    _playoutFramesLeft = 0;
+    delete[] _playoutBuffer;
+    _playoutBuffer = NULL;
+    // Written and closed by the writer thread, not waited for.
+    if (_outputWriter) {
+      _writers->Close(_outputWriter);
+      _outputWriter = NULL;
+    }
+  }
+  if (_recording)
+    _clock->AddClient(this);
 
   RTC_LOG(LS_INFO) << "Stopped playout capture to output file: "
                    << _outputFilename;
@@ -263,7 +272,9 @@ bool FileAudioDevice::Playing() const {
 }
 
 int32_t FileAudioDevice::StartRecording() {
-  _recording = true;
+  if (_recording) {
+    return 0;
+  }
 
   // Make sure we only create the buffer once.
   _recordingBufferSizeIn10MS =
@@ -272,20 +283,23 @@ int32_t FileAudioDevice::StartRecording() {
     _recordingBuffer = new int8_t[_recordingBufferSizeIn10MS];
   }
 
-  if (!_inputFilename.empty() &&
-      !_inputFile.OpenFile(_inputFilename.c_str(), true)) {
-    RTC_LOG(LS_ERROR) << "Failed to open audio input file: " << _inputFilename;
-    _recording = false;
-    delete[] _recordingBuffer;
-    _recordingBuffer = NULL;
-    return -1;
+  if (!_inputFilename.empty()) {
+    _inputSource = _sources->Get(_inputFilename);
+    _inputOffset = 0;
+    if (!_inputSource) {
+      RTC_LOG(LS_ERROR) << "Failed to open audio input file: "
+                        << _inputFilename;
+      delete[] _recordingBuffer;
+      _recordingBuffer = NULL;
+      return -1;
+    }
   }
 
-  _ptrThreadRec.reset(new rtc::PlatformThread(
-      RecThreadFunc, this, "webrtc_audio_module_capture_thread"));
-
-  _ptrThreadRec->Start();
-  _ptrThreadRec->SetPriority(rtc::kRealtimePriority);
+  {
+    rtc::CritScope lock(&_critSect);
+    _recording = true;
+  }
+  _clock->AddClient(this);
 
   RTC_LOG(LS_INFO) << "Started recording from input file: " << _inputFilename;
 
@@ -298,18 +312,19 @@ int32_t FileAudioDevice::StopRecording() {
     _recording = false;
   }
 
-  if (_ptrThreadRec) {
-    _ptrThreadRec->Stop();
-    _ptrThreadRec.reset();
-  }
-
-  rtc::CritScope lock(&_critSect);
-  _recordingFramesLeft = 0;
-  if (_recordingBuffer) {
-    delete[] _recordingBuffer;
-    _recordingBuffer = NULL;
+  _clock->RemoveClient(this);
+  {
+    rtc::CritScope lock(&_critSect);
+    _recordingFramesLeft = 0;
+    if (_recordingBuffer) {
+      delete[] _recordingBuffer;
+      _recordingBuffer = NULL;
+    }
+    // Stays mapped in the cache for the other devices.
+    _inputSource = NULL;
   }
-  _inputFile.CloseFile();
+  if (_playing)
+    _clock->AddClient(this);
 
   RTC_LOG(LS_INFO) << "Stopped recording from input file: " << _inputFilename;
   return 0;
@@ -444,76 +459,51 @@ void FileAudioDevice::AttachAudioBuffer(webrtc::AudioDeviceBuffer* audioBuffer)
   _ptrAudioBuffer->SetPlayoutChannels(0);
 }
 
-bool FileAudioDevice::PlayThreadFunc(void* pThis) {
-  return (static_cast<FileAudioDevice*>(pThis)->PlayThreadProcess());
+void FileAudioDevice::OnMediaTick() {
+  // Capture first, the frame played out in the same tick may depend on it.
+  if (_recording)
+    RecordingTick();
+  if (_playing)
+    PlayoutTick();
 }
 
-bool FileAudioDevice::RecThreadFunc(void* pThis) {
-  return (static_cast<FileAudioDevice*>(pThis)->RecThreadProcess());
-}
-
-bool FileAudioDevice::PlayThreadProcess() {
-  if (!_playing) {
-    return false;
-  }
-  int64_t currentTime = rtc::TimeMillis();
+void FileAudioDevice::PlayoutTick() {
+  // Not under the lock, the voice engine calls back into the device.
+  _ptrAudioBuffer->RequestPlayoutData(_playoutFramesIn10MS);
   _critSect.Enter();
 
-  if (_lastCallPlayoutMillis == 0 ||
-      currentTime - _lastCallPlayoutMillis >= 10) {
-    _critSect.Leave();
-    _ptrAudioBuffer->RequestPlayoutData(_playoutFramesIn10MS);
-    _critSect.Enter();
-
-    _playoutFramesLeft = _ptrAudioBuffer->GetPlayoutData(_playoutBuffer);
-    RTC_DCHECK_EQ(_playoutFramesIn10MS, _playoutFramesLeft);
-    if (_outputFile.is_open()) {
-      _outputFile.Write(_playoutBuffer, kPlayoutBufferSize);
-    }
-    _lastCallPlayoutMillis = currentTime;
+  _playoutFramesLeft = _ptrAudioBuffer->GetPlayoutData(_playoutBuffer);
+  RTC_DCHECK_EQ(_playoutFramesIn10MS, _playoutFramesLeft);
+  // Queued for the writer thread, a slow disk does not hold the lock.
+  if (_outputWriter) {
+    _outputWriter->Write(_playoutBuffer, kPlayoutBufferSize);
   }
   _playoutFramesLeft = 0;
   _critSect.Leave();
-
-  int64_t deltaTimeMillis = rtc::TimeMillis() - currentTime;
-  if (deltaTimeMillis < 10) {
-     webrtc::SleepMs(10 - deltaTimeMillis);
-  }
-
-  return true;
 }
 
-bool FileAudioDevice::RecThreadProcess() {
-  if (!_recording) {
-    return false;
-  }
-
-  int64_t currentTime = rtc::TimeMillis();
+void FileAudioDevice::RecordingTick() {
   _critSect.Enter();
-
-  if (_lastCallRecordMillis == 0 || currentTime - _lastCallRecordMillis >= 10) {
-    if (_inputFile.is_open()) {
-      if (_inputFile.Read(_recordingBuffer, kRecordingBufferSize) > 0) {
-        _ptrAudioBuffer->SetRecordedBuffer(_recordingBuffer,
-                                           _recordingFramesIn10MS);
-      } else {
-        _inputFile.Rewind();
-      }
-      _lastCallRecordMillis = currentTime;
-      _critSect.Leave();
-      _ptrAudioBuffer->DeliverRecordedData();
-      _critSect.Enter();
+  if (_inputSource) {
+    // Straight from the mapping unless the frame wraps around, the audio
+    // buffer copies it anyway.
+    const uint8_t* frame = _inputSource->data() + _inputOffset;
+    if (_inputOffset + kRecordingBufferSize <= _inputSource->size()) {
+      _inputOffset += kRecordingBufferSize;
+      if (_inputOffset == _inputSource->size())
+        _inputOffset = 0;
+    } else {
+      _inputSource->Read(&_inputOffset,
+                         reinterpret_cast<uint8_t*>(_recordingBuffer),
+                         kRecordingBufferSize);
+      frame = reinterpret_cast<const uint8_t*>(_recordingBuffer);
     }
+    _ptrAudioBuffer->SetRecordedBuffer(frame, _recordingFramesIn10MS);
+    _critSect.Leave();
+    _ptrAudioBuffer->DeliverRecordedData();
+    _critSect.Enter();
   }
-
   _critSect.Leave();
-
-  int64_t deltaTimeMillis = rtc::TimeMillis() - currentTime;
-  if (deltaTimeMillis < 10) {
-    webrtc::SleepMs(10 - deltaTimeMillis);
-  }
-
-  return true;
 }
 
 }  // namespace webrtc
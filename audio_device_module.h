@@ -14,37 +14,46 @@
 
 #include <stdio.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 
+#include "examples/rtc_gw/audio_file_writer.h"
+#include "examples/rtc_gw/audio_source_cache.h"
+#include "examples/rtc_gw/media_clock.h"
 #include "modules/audio_device/audio_device_generic.h"
 #include "rtc_base/criticalsection.h"
 #include "rtc_base/timeutils.h"
-#include "rtc_base/system/file_wrapper.h"
-
-namespace rtc {
-class PlatformThread;
-}  // namespace rtc
 
 namespace rtcgw {
 class EventWrapper;
 
 // This is a fake audio device which plays audio from a file as its microphone
-// and plays out into a file.
+// and plays out into a file. Frames are paced by a shared MediaClock rather
+// than by threads of its own.
 //class FileAudioDevice : public webrtc::AudioDeviceGeneric {
-class FileAudioDevice : public webrtc::AudioDeviceModule {
+class FileAudioDevice : public webrtc::AudioDeviceModule,
+                        public MediaClockClient {
  public:
   // Constructs a file audio device with |id|. It will read audio from
   // |inputFilename| and record output audio to |outputFilename|.
   //
   // The input file should be a readable 48k stereo raw file, and the output
   // file should point to a writable location. The output format will also be
-  // 48k stereo raw audio.
+  // 48k stereo raw audio. The input file is mapped through |sources|, shared
+  // by the devices playing it, and the output file is written by |writers|
+  // off the playout path.
+  //
+  // Reference counted, create it as a rtc::RefCountedObject<FileAudioDevice>
+  // so the voice engine references keep it alive.
   FileAudioDevice(const char* inputFilename,
-                  const char* outputFilename);
+                  const char* outputFilename,
+                  MediaClock* clock,
+                  AudioSourceCache* sources,
+                  AudioWriterThread* writers);
   virtual ~FileAudioDevice();
 
-  webrtc::AudioDeviceBuffer *Audio_device_buffer_;
+  std::unique_ptr<webrtc::AudioDeviceBuffer> Audio_device_buffer_;
 
   // Retrieve the currently utilized audio layer
   int32_t ActiveAudioLayer(
@@ -147,15 +156,14 @@ class FileAudioDevice : public webrtc::AudioDeviceModule {
   virtual int32_t EnableBuiltInNS(bool enable) { return -1; }
 
   //
-  virtual void AddRef() const { return; }
   virtual int32_t RegisterAudioCallback(webrtc::AudioTransport* audio_callback);
-  virtual rtc::RefCountReleaseStatus Release() const { return rtc::RefCountReleaseStatus::kDroppedLastRef; }
+
+  // MediaClockClient implementation.
+  void OnMediaTick() override;
 
  private:
-  static bool RecThreadFunc(void*);
-  static bool PlayThreadFunc(void*);
-  bool RecThreadProcess();
-  bool PlayThreadProcess();
+  void RecordingTick();
+  void PlayoutTick();
 
   int32_t _playout_index;
   int32_t _record_index;
@@ -170,17 +178,18 @@ class FileAudioDevice : public webrtc::AudioDeviceModule {
   size_t _recordingFramesIn10MS;
   size_t _playoutFramesIn10MS;
 
-  // TODO(pbos): Make plain members instead of pointers and stop resetting them.
-  std::unique_ptr<rtc::PlatformThread> _ptrThreadRec;
-  std::unique_ptr<rtc::PlatformThread> _ptrThreadPlay;
+  MediaClock* _clock;
+  AudioSourceCache* _sources;
+  // Mapped input file and the position of this device in it.
+  const AudioSource* _inputSource;
+  size_t _inputOffset;
 
-  bool _playing;
-  bool _recording;
-  int64_t _lastCallPlayoutMillis;
-  int64_t _lastCallRecordMillis;
+  // Read by the media clock thread on every tick.
+  std::atomic<bool> _playing;
+  std::atomic<bool> _recording;
 
-  webrtc::FileWrapper& _outputFile;
-  webrtc::FileWrapper& _inputFile;
+  AudioWriterThread* _writers;
+  AudioFileWriter* _outputWriter;
   std::string _outputFilename;
   std::string _inputFilename;
 };
@@ -0,0 +1,239 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/audio_file_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/stringutils.h"
+
+using rtc::sprintfn;
+
+namespace {
+
+// How often the writer thread looks for full batches, the ring holds
+// seconds so this only bounds the latency of the file content.
+const int kFlushIntervalMs = 50;
+// Names tried by an exclusive Open() before giving up.
+const int kMaxExclusiveAttempts = 100;
+
+// |filename| with "-<attempt>" before its extension, from the second
+// attempt on.
+std::string AttemptName(const std::string& filename, int attempt) {
+  if (attempt == 0)
+    return filename;
+  size_t dot = filename.rfind('.');
+  size_t slash = filename.rfind('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    dot = filename.size();
+  return filename.substr(0, dot) + "-" + std::to_string(attempt) +
+         filename.substr(dot);
+}
+
+}  // namespace
+
+// Bound to references by std::min().
+const size_t AudioFileWriter::kRingSize;
+const size_t AudioFileWriter::kBatchSize;
+
+AudioFileWriter::AudioFileWriter(AudioWriterThread* owner, int fd,
+                                 const std::string& filename)
+  : owner_(owner),
+    fd_(fd),
+    filename_(filename),
+    ring_(new uint8_t[kRingSize]),
+    head_(0),
+    tail_(0) {
+  owner_->files_++;
+}
+
+AudioFileWriter::~AudioFileWriter() {
+  close(fd_);
+  owner_->files_--;
+}
+
+bool AudioFileWriter::Write(const void* data, size_t len) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  uint64_t tail = tail_.load(std::memory_order_acquire);
+  if (kRingSize - (head - tail) < len) {
+    owner_->overruns_++;
+    return false;
+  }
+  size_t pos = head % kRingSize;
+  size_t first = std::min(len, kRingSize - pos);
+  memcpy(ring_.get() + pos, data, first);
+  memcpy(ring_.get(), static_cast<const uint8_t*>(data) + first, len - first);
+  head_.store(head + len, std::memory_order_release);
+  return true;
+}
+
+void AudioFileWriter::Flush(bool all) {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  while (head - tail >= kBatchSize || (all && head != tail)) {
+    // Batches start on a batch boundary of the ring, they never wrap.
+    size_t pos = tail % kRingSize;
+    size_t len = std::min<uint64_t>(head - tail, kRingSize - pos);
+    if (!all)
+      len = std::min(len, kBatchSize);
+    const uint8_t* data = ring_.get() + pos;
+    size_t left = len;
+    while (left > 0) {
+      ssize_t written = write(fd_, data, left);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0) {
+        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": failed to write:"
+                          << filename_ << " errno:" << errno;
+        owner_->write_errors_++;
+        break;  // Dropped, the ring must not fill up.
+      }
+      data += written;
+      left -= written;
+    }
+    tail += len;
+    tail_.store(tail, std::memory_order_release);
+    owner_->batches_++;
+    owner_->bytes_written_ += len - left;
+  }
+}
+
+AudioWriterThread::AudioWriterThread()
+  : wake_(false, false),
+    running_(false),
+    files_(0),
+    bytes_written_(0),
+    batches_(0),
+    overruns_(0),
+    write_errors_(0) {
+}
+
+AudioWriterThread::~AudioWriterThread() {
+  Stop();
+}
+
+bool AudioWriterThread::Start() {
+  RTC_DCHECK(!running_);
+  running_ = true;
+  thread_.reset(new rtc::PlatformThread(ThreadFunc, this,
+                                        "rtc_gw_audio_writer"));
+  thread_->Start();
+  return true;
+}
+
+void AudioWriterThread::Stop() {
+  if (running_) {
+    running_ = false;
+    wake_.Set();
+    thread_->Stop();
+    thread_.reset();
+  }
+  // The writers opened or closed since the last pass are drained too.
+  std::vector<AudioFileWriter*> closed;
+  Update(&closed);
+  for (auto& writer : writers_)
+    writer->Flush(true);
+  writers_.clear();
+}
+
+AudioFileWriter* AudioWriterThread::Open(const std::string& filename,
+                                         bool exclusive) {
+  // Nothing would ever write or free it.
+  RTC_DCHECK(running_);
+  if (!running_) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": writer thread stopped, not "
+                      << "recording:" << filename;
+    return NULL;
+  }
+  int flags = O_WRONLY | O_CREAT | (exclusive ? O_EXCL : O_TRUNC);
+  std::string name = filename;
+  int fd = open(name.c_str(), flags, 0644);
+  for (int attempt = 1;
+       fd < 0 && errno == EEXIST && attempt < kMaxExclusiveAttempts;
+       attempt++) {
+    name = AttemptName(filename, attempt);
+    fd = open(name.c_str(), flags, 0644);
+  }
+  if (fd < 0) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": failed to create:" << name
+                      << " errno:" << errno;
+    return NULL;
+  }
+  AudioFileWriter* writer = new AudioFileWriter(this, fd, name);
+  rtc::CritScope lock(&lock_);
+  opened_.push_back(writer);
+  return writer;
+}
+
+void AudioWriterThread::Close(AudioFileWriter* writer) {
+  // Stop() flushed and deleted every writer.
+  RTC_DCHECK(running_);
+  if (!running_)
+    return;
+  {
+    rtc::CritScope lock(&lock_);
+    closed_.push_back(writer);
+  }
+  wake_.Set();
+}
+
+void AudioWriterThread::Update(std::vector<AudioFileWriter*>* closed) {
+  rtc::CritScope lock(&lock_);
+  for (AudioFileWriter* writer : opened_)
+    writers_.emplace_back(writer);
+  opened_.clear();
+  closed->swap(closed_);
+}
+
+bool AudioWriterThread::ThreadFunc(void* writer_thread) {
+  return static_cast<AudioWriterThread*>(writer_thread)->Process();
+}
+
+bool AudioWriterThread::Process() {
+  wake_.Wait(kFlushIntervalMs);
+  if (!running_)
+    return false;
+  std::vector<AudioFileWriter*> closed;
+  Update(&closed);
+  for (auto& writer : writers_)
+    writer->Flush(false);
+  for (AudioFileWriter* writer : closed) {
+    writer->Flush(true);
+    writers_.erase(std::find_if(
+        writers_.begin(), writers_.end(),
+        [writer](const std::unique_ptr<AudioFileWriter>& it) {
+          return it.get() == writer;
+        }));
+  }
+  return true;
+}
+
+std::string AudioWriterThread::GetStats() const {
+  char buffer[256];
+  sprintfn(buffer, sizeof(buffer),
+           "recording_files: %i\n"
+           "recording_bytes_written: %llu\n"
+           "recording_batches: %llu\n"
+           "recording_overruns: %llu\n"
+           "recording_write_errors: %llu\n",
+           files_.load(),
+           static_cast<unsigned long long>(bytes_written_.load()),
+           static_cast<unsigned long long>(batches_.load()),
+           static_cast<unsigned long long>(overruns_.load()),
+           static_cast<unsigned long long>(write_errors_.load()));
+  return buffer;
+}
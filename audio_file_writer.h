@@ -0,0 +1,114 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_AUDIO_FILE_WRITER_H_
+#define PEERCONNECTION_AUDIO_FILE_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtc_base/criticalsection.h"
+#include "rtc_base/event.h"
+#include "rtc_base/platform_thread.h"
+
+class AudioWriterThread;
+
+// A recording file fed from a realtime thread. Frames go to a lock-free
+// single producer, single consumer ring and the AudioWriterThread writes
+// them to disk in large batches, a slow disk never stalls the producer.
+class AudioFileWriter {
+ public:
+  // About 5 s of 48 kHz stereo, a whole number of batches.
+  static const size_t kRingSize = 1024 * 1024;
+  // Written at once, file offsets stay block aligned.
+  static const size_t kBatchSize = 64 * 1024;
+
+  ~AudioFileWriter();
+
+  // Producer side, never blocks. The frame is dropped and counted as an
+  // overrun if the disk fell behind and the ring is full.
+  bool Write(const void* data, size_t len);
+
+  const std::string& filename() const { return filename_; }
+
+ protected:
+  friend class AudioWriterThread;
+
+  AudioFileWriter(AudioWriterThread* owner, int fd,
+                  const std::string& filename);
+  // Consumer side, writes the whole batches available, everything if
+  // |all|.
+  void Flush(bool all);
+
+  AudioWriterThread* owner_;
+  int fd_;
+  std::string filename_;
+  std::unique_ptr<uint8_t[]> ring_;
+  // Total bytes pushed and written, their difference is in the ring.
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+};
+
+// The thread writing every AudioFileWriter to disk, so the number of
+// recordings does not add threads.
+class AudioWriterThread {
+ public:
+  AudioWriterThread();
+  ~AudioWriterThread();
+
+  bool Start();
+  // Writes what is left and closes every file, the writers still open are
+  // deleted: their producers must be gone.
+  void Stop();
+
+  // Creates |filename|, NULL on failure or once stopped. An existing file
+  // is truncated, unless |exclusive|: it is then kept and the first free
+  // "<name>-<n>.<extension>" is created instead.
+  AudioFileWriter* Open(const std::string& filename, bool exclusive = false);
+  // The producer must be done with |writer|, what is left is written and
+  // the file closed by the thread, the caller does not wait for the disk.
+  // Only before Stop(), which already closed |writer|.
+  void Close(AudioFileWriter* writer);
+
+  // Plain text counters.
+  std::string GetStats() const;
+
+ protected:
+  friend class AudioFileWriter;
+
+  static bool ThreadFunc(void* writer_thread);
+  bool Process();
+  // Takes the writers opened and closed since the last pass.
+  void Update(std::vector<AudioFileWriter*>* closed);
+
+  std::unique_ptr<rtc::PlatformThread> thread_;
+  rtc::Event wake_;
+  // Read by the thread.
+  std::atomic<bool> running_;
+  // Guards |opened_| and |closed_| only, never held while writing.
+  rtc::CriticalSection lock_;
+  std::vector<AudioFileWriter*> opened_;
+  std::vector<AudioFileWriter*> closed_;
+  // Only used by the thread.
+  std::vector<std::unique_ptr<AudioFileWriter> > writers_;
+
+  std::atomic<int> files_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> batches_;
+  std::atomic<uint64_t> overruns_;
+  std::atomic<uint64_t> write_errors_;
+};
+
+#endif  // PEERCONNECTION_AUDIO_FILE_WRITER_H_
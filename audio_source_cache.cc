@@ -0,0 +1,102 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/audio_source_cache.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+
+AudioSource::AudioSource(const uint8_t* data, size_t size)
+  : data_(data),
+    size_(size) {
+}
+
+AudioSource::~AudioSource() {
+  munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+std::unique_ptr<AudioSource> AudioSource::Map(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": failed to open:" << filename;
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": empty or unreadable:" << filename;
+    close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file, not the descriptor.
+  close(fd);
+  if (data == MAP_FAILED) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": failed to map:" << filename;
+    return nullptr;
+  }
+  // Read over and over by every call, keep it resident.
+  madvise(data, size, MADV_WILLNEED);
+  RTC_LOG(INFO) << __FUNCTION__ << " " << filename << " bytes:" << size;
+  return std::unique_ptr<AudioSource>(
+      new AudioSource(static_cast<const uint8_t*>(data), size));
+}
+
+void AudioSource::Read(size_t* offset, uint8_t* buffer, size_t len) const {
+  RTC_DCHECK_LT(*offset, size_);
+  while (len > 0) {
+    size_t take = std::min(len, size_ - *offset);
+    memcpy(buffer, data_ + *offset, take);
+    buffer += take;
+    len -= take;
+    *offset += take;
+    if (*offset == size_)
+      *offset = 0;
+  }
+}
+
+AudioSourceCache::AudioSourceCache()
+  : mapped_bytes_(0) {
+}
+
+AudioSourceCache::~AudioSourceCache() {
+}
+
+const AudioSource* AudioSourceCache::Get(const std::string& filename) {
+  rtc::CritScope lock(&lock_);
+  auto it = sources_.find(filename);
+  if (it != sources_.end())
+    return it->second.get();
+  std::unique_ptr<AudioSource> source = AudioSource::Map(filename);
+  if (!source)
+    return NULL;
+  const AudioSource* mapped = source.get();
+  mapped_bytes_ += source->size();
+  sources_[filename] = std::move(source);
+  return mapped;
+}
+
+size_t AudioSourceCache::sources() const {
+  rtc::CritScope lock(&lock_);
+  return sources_.size();
+}
+
+size_t AudioSourceCache::mapped_bytes() const {
+  rtc::CritScope lock(&lock_);
+  return mapped_bytes_;
+}
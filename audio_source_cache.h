@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_AUDIO_SOURCE_CACHE_H_
+#define PEERCONNECTION_AUDIO_SOURCE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "rtc_base/criticalsection.h"
+
+// A raw audio file mapped read-only in memory.
+class AudioSource {
+ public:
+  ~AudioSource();
+
+  // NULL if the file can not be mapped or is empty.
+  static std::unique_ptr<AudioSource> Map(const std::string& filename);
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Copies |len| bytes from |*offset| into |buffer|, wrapping around at the
+  // end of the file, and advances |*offset|.
+  void Read(size_t* offset, uint8_t* buffer, size_t len) const;
+
+ protected:
+  AudioSource(const uint8_t* data, size_t size);
+
+  const uint8_t* data_;
+  size_t size_;
+};
+
+// Audio files played by the devices, each one is mapped once whatever the
+// number of calls playing it and stays mapped until the cache is
+// destroyed. Callers only keep their own read offset, reading is a memory
+// copy instead of a syscall every 10 ms.
+class AudioSourceCache {
+ public:
+  AudioSourceCache();
+  ~AudioSourceCache();
+
+  // Maps |filename| on first use, NULL if it can not be mapped. Safe from
+  // any thread.
+  const AudioSource* Get(const std::string& filename);
+
+  size_t sources() const;
+  size_t mapped_bytes() const;
+
+ protected:
+  rtc::CriticalSection lock_;
+  std::map<std::string, std::unique_ptr<AudioSource> > sources_;
+  size_t mapped_bytes_;
+};
+
+#endif  // PEERCONNECTION_AUDIO_SOURCE_CACHE_H_
@@ -0,0 +1,182 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/certificate_pool.h"
+
+#include <stdio.h>
+
+#include <utility>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/sslidentity.h"
+
+namespace {
+
+const char kCertificateCommonName[] = "rtc_gw";
+// Lifetime of the certificates generated by a PeerConnection.
+const time_t kDefaultLifetimeS = 30 * 86400;
+
+bool ReadFile(const std::string& path, std::string* data) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file)
+    return false;
+  char buffer[4096];
+  size_t len;
+  data->clear();
+  while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data->append(buffer, len);
+  fclose(file);
+  return true;
+}
+
+}  // namespace
+
+CertificatePool::CertificatePool(rtc::Thread* signaling_thread)
+  : signaling_thread_(signaling_thread),
+    size_limit_(0),
+    next_(0),
+    rotation_s_(0),
+    lifetime_s_(kDefaultLifetimeS),
+    rotations_(0) {
+}
+
+CertificatePool::~CertificatePool() {
+  Terminate();
+}
+
+bool CertificatePool::Init(int size, int rotation_s,
+                           const std::string& certificate_file,
+                           const std::string& private_key_file) {
+  RTC_DCHECK(certificates_.empty());
+  if (rotation_s < 0 || rotation_s > kMaxRotationS) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": invalid rotation:" << rotation_s
+                      << "s, up to " << kMaxRotationS << "s";
+    return false;
+  }
+  if (size <= 0)
+    return true;
+  // A certificate is replaced after |size| rotations, one more covers the
+  // sessions started just before.
+  int64_t cycle_s = static_cast<int64_t>(size) * rotation_s;
+  if (cycle_s > kMaxCycleS) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": " << size << " certificates "
+                      << "rotated every " << rotation_s << "s, up to "
+                      << kMaxCycleS << "s of validity";
+    return false;
+  }
+  size_limit_ = size;
+  rotation_s_ = rotation_s;
+  if (cycle_s + rotation_s > kDefaultLifetimeS)
+    lifetime_s_ = static_cast<time_t>(cycle_s + rotation_s);
+  certificate_file_ = certificate_file;
+  private_key_file_ = private_key_file;
+  for (int i = 0; i < size; i++) {
+    rtc::scoped_refptr<rtc::RTCCertificate> certificate = Create();
+    if (!certificate) {
+      certificates_.clear();
+      return false;
+    }
+    certificates_.push_back(certificate);
+  }
+  RTC_LOG(INFO) << __FUNCTION__ << " certificates:" << certificates_.size()
+                << " rotation:" << rotation_s_ << "s lifetime:"
+                << lifetime_s_ << "s";
+
+  if (rotation_s_ > 0) {
+    key_thread_ = rtc::Thread::Create();
+    key_thread_->SetName("rtc_gw_certificates", nullptr);
+    key_thread_->Start();
+    signaling_thread_->PostDelayed(RTC_FROM_HERE, rotation_s_ * 1000, this,
+                                   MSG_ROTATE);
+  }
+  return true;
+}
+
+void CertificatePool::Terminate() {
+  if (!key_thread_ && certificates_.empty())
+    return;
+  // No certificate is generated from now on.
+  if (key_thread_) {
+    key_thread_->Stop();
+    key_thread_.reset();
+  }
+  // The rotation and its result run on the signaling thread, so does the
+  // teardown: dropping what is pending first, then the certificates.
+  signaling_thread_->Invoke<void>(RTC_FROM_HERE, [this] {
+    signaling_thread_->Clear(this);
+    invoker_.Clear();
+    certificates_.clear();
+  });
+}
+
+rtc::scoped_refptr<rtc::RTCCertificate> CertificatePool::Next() {
+  RTC_DCHECK(signaling_thread_->IsCurrent());
+  if (certificates_.empty())
+    return nullptr;
+  next_ = (next_ + 1) % certificates_.size();
+  return certificates_[next_];
+}
+
+rtc::scoped_refptr<rtc::RTCCertificate> CertificatePool::Create() const {
+  std::unique_ptr<rtc::SSLIdentity> identity;
+  if (!certificate_file_.empty()) {
+    std::string certificate;
+    std::string private_key;
+    if (!ReadFile(certificate_file_, &certificate) ||
+        !ReadFile(private_key_file_, &private_key)) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": can not read "
+                        << certificate_file_ << " or " << private_key_file_;
+      return nullptr;
+    }
+    identity.reset(rtc::SSLIdentity::FromPEMStrings(private_key,
+                                                    certificate));
+  } else {
+    identity.reset(rtc::SSLIdentity::GenerateWithExpiration(
+        kCertificateCommonName, rtc::KeyParams::ECDSA(rtc::EC_NIST_P256),
+        lifetime_s_));
+  }
+  if (!identity) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": failed to create the identity";
+    return nullptr;
+  }
+  return rtc::RTCCertificate::Create(std::move(identity));
+}
+
+void CertificatePool::OnRotated(
+    rtc::scoped_refptr<rtc::RTCCertificate> certificate) {
+  RTC_DCHECK(signaling_thread_->IsCurrent());
+  if (certificate) {
+    certificates_.push_back(certificate);
+    if (certificates_.size() > size_limit_)
+      certificates_.pop_front();
+    rotations_++;
+  }
+  signaling_thread_->PostDelayed(RTC_FROM_HERE, rotation_s_ * 1000, this,
+                                 MSG_ROTATE);
+}
+
+void CertificatePool::OnMessage(rtc::Message* msg) {
+  switch (msg->message_id) {
+    case MSG_ROTATE:
+      // Generated on the key thread, added back on the signaling thread.
+      invoker_.AsyncInvoke<void>(RTC_FROM_HERE, key_thread_.get(), [this] {
+        rtc::scoped_refptr<rtc::RTCCertificate> certificate = Create();
+        invoker_.AsyncInvoke<void>(RTC_FROM_HERE, signaling_thread_,
+                                   [this, certificate] {
+          OnRotated(certificate);
+        });
+      });
+      break;
+    default:
+      RTC_NOTREACHED();
+      break;
+  }
+}
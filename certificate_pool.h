@@ -0,0 +1,85 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_CERTIFICATE_POOL_H_
+#define PEERCONNECTION_CERTIFICATE_POOL_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "rtc_base/asyncinvoker.h"
+#include "rtc_base/messagehandler.h"
+#include "rtc_base/rtccertificate.h"
+#include "rtc_base/thread.h"
+
+// DTLS certificates shared by the sessions. Without one in its
+// configuration every PeerConnection generates a key pair while the offer
+// waits, here they are generated at startup or loaded from PEM files, then
+// replaced on a schedule from a dedicated thread. A session keeps the
+// certificate it was given for its whole life.
+class CertificatePool : public rtc::MessageHandler {
+ public:
+  enum MessageID {
+    MSG_ROTATE = 1,
+  };
+
+  // Longest rotation period, in milliseconds it must fit a PostDelayed()
+  // delay. About 24 days.
+  static const int kMaxRotationS = 2000000;
+  // Longest life of a certificate, the pool size times the rotation
+  // period. A year.
+  static const int kMaxCycleS = 365 * 86400;
+
+  explicit CertificatePool(rtc::Thread* signaling_thread);
+  ~CertificatePool();
+
+  // Fills the pool with |size| certificates, read from |certificate_file|
+  // and |private_key_file| if set. Every |rotation_s| the oldest one is
+  // replaced by a new one, or by the files read again, 0 never rotates.
+  // Generated certificates are valid for the whole cycle, the files are
+  // used as they are.
+  bool Init(int size, int rotation_s, const std::string& certificate_file,
+            const std::string& private_key_file);
+  void Terminate();
+
+  // Certificate for a new session, round robin over the pool. NULL if the
+  // pool is empty, the PeerConnection then generates its own.
+  rtc::scoped_refptr<rtc::RTCCertificate> Next();
+
+  size_t size() const { return certificates_.size(); }
+  uint64_t rotations() const { return rotations_; }
+
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
+ protected:
+  // Called on any thread.
+  rtc::scoped_refptr<rtc::RTCCertificate> Create() const;
+  void OnRotated(rtc::scoped_refptr<rtc::RTCCertificate> certificate);
+
+  rtc::Thread* signaling_thread_;
+  // Generates the replacement certificates off the signaling thread.
+  std::unique_ptr<rtc::Thread> key_thread_;
+  rtc::AsyncInvoker invoker_;
+  std::deque<rtc::scoped_refptr<rtc::RTCCertificate> > certificates_;
+  size_t size_limit_;
+  size_t next_;
+  int rotation_s_;
+  time_t lifetime_s_;
+  std::string certificate_file_;
+  std::string private_key_file_;
+  uint64_t rotations_;
+};
+
+#endif  // PEERCONNECTION_CERTIFICATE_POOL_H_
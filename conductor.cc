@@ -14,187 +14,149 @@
 #include <utility>
 #include <vector>
 
-#include "api/test/fakeconstraints.h"
-#include "examples/rtc_gw/defaults.h"
-#include "media/engine/webrtcvideocapturerfactory.h"
-#include "modules/video_capture/video_capture_factory.h"
+#include "rtc_base/arraysize.h"
 #include "rtc_base/checks.h"
-#include "rtc_base/json.h"
 #include "rtc_base/logging.h"
+#include "rtc_base/stringutils.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/timeutils.h"
 
-#include "api/audio_codecs/builtin_audio_decoder_factory.h"
-#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+using rtc::sprintfn;
 
-// Names used for a IceCandidate JSON object.
-const char kCandidateSdpMidName[] = "sdpMid";
-const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
-const char kCandidateSdpName[] = "candidate";
+namespace {
 
-// Names used for a SessionDescription JSON object.
-const char kSessionDescriptionTypeName[] = "type";
-const char kSessionDescriptionSdpName[] = "sdp";
+// Sessions torn down per posted message, new offers and BYEs are handled
+// between two batches.
+const size_t kReapBatchSize = 8;
 
-#define DTLS_ON  true
-#define DTLS_OFF false
+}  // namespace
 
-class DummySetSessionDescriptionObserver
-    : public webrtc::SetSessionDescriptionObserver {
- public:
-  static DummySetSessionDescriptionObserver* Create() {
-    return
-        new rtc::RefCountedObject<DummySetSessionDescriptionObserver>();
-  }
-  virtual void OnSuccess() {
-    RTC_LOG(INFO) << __FUNCTION__;
-  }
-  virtual void OnFailure(const std::string& error) {
-    RTC_LOG(INFO) << __FUNCTION__ << " " << error;
-  }
+void Conductor::PhaseStats::Add(int64_t ms) {
+  count++;
+  total_ms += ms;
+  if (ms > max_ms)
+    max_ms = ms;
+}
 
- protected:
-  DummySetSessionDescriptionObserver() {}
-  ~DummySetSessionDescriptionObserver() {}
-};
+size_t Conductor::FormatPhase(char* buffer, size_t size, const char* prefix,
+                              const char* name, const PhaseStats& phase) {
+  return sprintfn(buffer, size,
+                  "%s%s_count: %llu\n"
+                  "%s%s_avg_ms: %lld\n"
+                  "%s%s_max_ms: %lld\n",
+                  prefix, name, static_cast<unsigned long long>(phase.count),
+                  prefix, name, phase.count ?
+                      static_cast<long long>(phase.total_ms / phase.count)
+                      : 0LL,
+                  prefix, name, static_cast<long long>(phase.max_ms));
+}
 
-Conductor::Conductor(PeerConnectionListener* client) : peer_id_(-1), client_(client) {
+Conductor::Conductor(PeerConnectionListener* client,
+                     PeerConnectionFactoryPool* factory_pool,
+                     const SessionConfig& session_config)
+  : client_(client),
+    listener_thread_(rtc::Thread::Current()),
+    factory_pool_(factory_pool),
+    session_config_(session_config),
+    session_pool_(this, factory_pool),
+    session_pool_size_(0),
+    sessions_created_(0),
+    answers_timed_out_(0) {
+  for (int reason = 0; reason < SESSION_END_REASON_COUNT; reason++)
+    sessions_ended_[reason] = 0;
   client_->RegisterObserver(this);
 }
 
 Conductor::~Conductor() {
-  RTC_DCHECK(peer_connection_.get() == NULL);
+  RTC_DCHECK(sessions_.empty());
+  RTC_DCHECK(closing_sessions_.empty());
+  listener_thread_->Clear(this);
 }
 
 bool Conductor::connection_active() const {
-  return peer_connection_.get() != NULL;
+  return !sessions_.empty();
 }
 
 void Conductor::Close() {
   client_->SignOut();
-  DeletePeerConnection();
+  session_pool_.Clear();
+  CloseAllSessions();
+  ReapSessions(closing_sessions_.size());
 }
 
-bool Conductor::InitializePeerConnection() {
-  RTC_DCHECK(peer_connection_factory_.get() == NULL);
-  RTC_DCHECK(peer_connection_.get() == NULL);
-  // CustomAudioModule
-  signaling_thread_ = new rtc::Thread();
-  rtcgw::FileAudioDevice *audio_device_ = new rtcgw::FileAudioDevice("/audio/input_48K_16bits_pcm.raw", "/audio/recording.raw");
-  signaling_thread_->Start();
-
-  peer_connection_factory_ = webrtc::CreatePeerConnectionFactory(
-     signaling_thread_,
-     rtc::Thread::Current(),
-     rtc::Thread::Current(),
-     audio_device_,
-     webrtc::CreateBuiltinAudioEncoderFactory(),
-     webrtc::CreateBuiltinAudioDecoderFactory(),
-     nullptr,
-     nullptr
-  );
-
-  if (!peer_connection_factory_.get()) {
-    RTC_LOG(INFO) << "Error Failed to initialize PeerConnectionFactory";
-    DeletePeerConnection();
-    return false;
-  }
-
-  if (!CreatePeerConnection(DTLS_ON)) {
-    RTC_LOG(INFO) << "Error: CreatePeerConnection failed";
-    DeletePeerConnection();
-  }
-  AddStreams();
-  return peer_connection_.get() != NULL;
+void Conductor::CloseSession(int session_id) {
+  auto it = sessions_.find(session_id);
+  if (it == sessions_.end())
+    return;
+  it->second->Close();
+  if (closing_sessions_.empty())
+    listener_thread_->Post(RTC_FROM_HERE, this, MSG_REAP_SESSIONS);
+  closing_sessions_.push_back(it->second);
+  sessions_.erase(it);
+  // After any reply already queued for the session.
+  QueueMessage(session_id, "", PENDING_SESSION_CLOSED);
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << session_id
+                << " active sessions:" << sessions_.size();
 }
 
-bool Conductor::CreatePeerConnection(bool dtls) {
-  RTC_DCHECK(peer_connection_factory_.get() != NULL);
-  RTC_DCHECK(peer_connection_.get() == NULL);
-
-  webrtc::PeerConnectionInterface::RTCConfiguration config;
-  config.audio_jitter_buffer_max_packets = 100;
-  config.audio_jitter_buffer_fast_accelerate = true;
-  RTC_LOG(INFO) << "config.audio_jitter_buffer_fast_accelerate: " << config.audio_jitter_buffer_fast_accelerate;
-
-  webrtc::PeerConnectionInterface::IceServer server;
-  server.uri = GetPeerConnectionString();
-  config.servers.push_back(server);
-
-  webrtc::FakeConstraints constraints;
-  if (dtls) {
-    constraints.AddOptional(webrtc::MediaConstraintsInterface::kEnableDtlsSrtp,
-                            "true");
-    RTC_LOG(INFO) << __FUNCTION__ << " DTLS constraint: true ";
-  } else {
-    constraints.AddOptional(webrtc::MediaConstraintsInterface::kEnableDtlsSrtp,
-                            "false");
-    RTC_LOG(INFO) << __FUNCTION__ << " DTLS constraint: false ";
+void Conductor::ReapSessions(size_t max) {
+  for (size_t i = 0; i < max && !closing_sessions_.empty(); i++) {
+    rtc::scoped_refptr<Session> session = closing_sessions_.front();
+    closing_sessions_.pop_front();
+    int64_t start = rtc::TimeMillis();
+    session->Teardown();
+    factory_pool_->Release(session->shard());
+    teardown_stats_.Add(rtc::TimeMillis() - start);
   }
-  constraints.AddOptional(webrtc::MediaConstraintsInterface::kOfferToReceiveVideo,
-                            "false");
-  RTC_LOG(INFO) << __FUNCTION__ << " offer receive video: false ";
-  peer_connection_ = peer_connection_factory_->CreatePeerConnection(
-      config, &constraints, NULL, NULL, this);
-  return peer_connection_.get() != NULL;
-}
-
-void Conductor::DeletePeerConnection() {
-  peer_connection_ = NULL;
-  active_streams_.clear();
-  peer_connection_factory_ = NULL;
-  peer_id_ = -1;
-}
-
-void Conductor::EnsureStreamingUI() {
-  RTC_DCHECK(peer_connection_.get() != NULL);
+  if (!closing_sessions_.empty())
+    listener_thread_->Post(RTC_FROM_HERE, this, MSG_REAP_SESSIONS);
 }
 
 //
-// PeerConnectionObserver implementation.
+// SessionObserver implementation.
 //
 
-// Called when a remote stream is added
-void Conductor::OnAddStream(
-    rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
-    RTC_LOG(INFO) << __FUNCTION__ << " " << stream->id();
-    // QueueThreadCallback(NEW_STREAM_ADDED, stream.release());
+void Conductor::OnSessionAnswer(int session_id, const std::string& sdp) {
+  auto it = sessions_.find(session_id);
+  if (it != sessions_.end()) {
+    const SessionTimings& timings = it->second->timings();
+    create_answer_stats_.Add(timings.answer_created_ms - timings.offer_ms);
+    gathering_stats_.Add(timings.answer_sent_ms - timings.answer_created_ms);
+    offer_to_answer_stats_.Add(timings.answer_sent_ms - timings.offer_ms);
+    mode_offer_to_answer_stats_[it->second->media_security()].Add(
+        timings.answer_sent_ms - timings.offer_ms);
+    if (timings.timed_out)
+      answers_timed_out_++;
+  }
+  QueueMessage(session_id, sdp);
 }
 
-void Conductor::OnRemoveStream(
-    rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
-    RTC_LOG(INFO) << __FUNCTION__ << " " << stream->id();
-    // QueueThreadCallback(STREAM_REMOVED, stream.release());
+void Conductor::OnSessionCandidate(int session_id,
+                                   const std::string& candidate) {
+  QueueMessage(session_id, candidate, PENDING_CANDIDATE);
 }
 
+void Conductor::OnSessionConnected(int session_id) {
+  auto it = sessions_.find(session_id);
+  if (it == sessions_.end())
+    return;
+  const SessionTimings& timings = it->second->timings();
+  if (timings.answer_sent_ms == 0)
+    return;
+  mode_answer_to_connected_stats_[it->second->media_security()].Add(
+      timings.ice_connected_ms - timings.answer_sent_ms);
+}
 
-void Conductor::OnIceGatheringChange(
-    webrtc::PeerConnectionInterface::IceGatheringState new_state) {
-
-    RTC_LOG(INFO) << __FUNCTION__ << " ? " << webrtc::PeerConnectionInterface::kIceGatheringComplete << " == " << new_state;
-};
-
-void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
-    RTC_LOG(WARNING) << __FUNCTION__ << " " << candidate->sdp_mline_index();
-
-//    std::vector<cricket::Candidate> candidates;
-//    candidates.push_back(candidate->candidate());
-//    peer_connection_->RemoveIceCandidates(candidates);
-
-    std::string sdp;
-    if (!candidate->ToString(&sdp)) {
-        RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
-        return;
-    } else {
-        RTC_LOG(WARNING) << "Ice Candidate:" << sdp;
-    }
-
-    std::size_t found = sdp.find(client_->listen_ip);
-    if (found != std::string::npos) {
-       RTC_LOG(WARNING) << "main "<< client_->listen_ip <<" Ice Candidate:" << sdp;
-       std::string sdp;
-       desc_->ToString(&sdp);
-       QueueMessage(sdp);
-       RTC_LOG(INFO) << __FUNCTION__ << "queuing:" << sdp;
-    }
+void Conductor::OnSessionEnded(int session_id, SessionEndReason reason) {
+  auto it = sessions_.find(session_id);
+  if (it == sessions_.end())
+    return;
+  sessions_ended_[reason]++;
+  // The client still waits for the answer, fail it instead of leaving it
+  // hanging.
+  if (it->second->timings().answer_sent_ms == 0)
+    QueueError(session_id, ErrorStatus(reason), Session::EndReasonName(reason));
+  CloseSession(session_id);
 }
 
 //
@@ -205,10 +167,14 @@ void Conductor::OnSignedIn() {
   RTC_LOG(INFO) << __FUNCTION__;
 }
 
+void Conductor::CloseAllSessions() {
+  while (!sessions_.empty())
+    CloseSession(sessions_.begin()->first);
+}
+
 void Conductor::OnDisconnected() {
   RTC_LOG(INFO) << __FUNCTION__;
-
-  DeletePeerConnection();
+  CloseAllSessions();
 }
 
 void Conductor::OnPeerConnected(int id, const std::string& name) {
@@ -216,114 +182,135 @@ void Conductor::OnPeerConnected(int id, const std::string& name) {
 }
 
 void Conductor::OnPeerDisconnected(int id) {
-  RTC_LOG(INFO) << __FUNCTION__;
-  if (id == peer_id_) {
-    RTC_LOG(INFO) << "Our peer disconnected";
-      QueueMessage("peer disconnected");
-      DeletePeerConnection();
-      // QueueThreadCallback(PEER_CONNECTION_CLOSED, NULL);
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id;
+  if (sessions_.find(id) == sessions_.end()) {
+    RTC_LOG(WARNING) << "BYE for unknown session:" << id;
+    QueueError(id, 404, "unknown session");
+    return;
   }
+  QueueMessage(id, "peer disconnected");
+  CloseSession(id);
 }
 
 void Conductor::OnMessageFromPeer(int peer_id, const std::string& message) {
-  RTC_DCHECK(peer_id_ == peer_id || peer_id_ == -1);
   RTC_DCHECK(!message.empty());
-  RTC_LOG(INFO) << __FUNCTION__ ;
-
-  if (!peer_connection_.get()) {
-    RTC_DCHECK(peer_id_ == -1);
-    peer_id_ = peer_id;
-
-    if (!InitializePeerConnection()) {
-      RTC_LOG(LS_ERROR) << "Failed to initialize our PeerConnection instance";
-      client_->SignOut();
-      return;
-    } else {
-      RTC_LOG(LS_ERROR) << "Ok initialize our PeerConnection instance";
-    }
-  } else if (peer_id != peer_id_) {
-    RTC_DCHECK(peer_id_ != -1);
-    RTC_LOG(WARNING) << "Received a message from unknown peer while already in a "
-                    "conversation with a different peer.";
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << peer_id;
+
+  auto it = sessions_.find(peer_id);
+  if (it == sessions_.end()) {
+    OnOfferFromPeer(peer_id, message, "", "");
     return;
   }
+  it->second->OnMessageFromPeer(message);
+}
 
-  Json::Reader reader;
-  Json::Value jmessage;
-  if (!reader.parse(message, jmessage)) {
-    RTC_LOG(WARNING) << "Received unknown message. " << message;
-    return;
+bool Conductor::OnOfferFromPeer(int session_id, const std::string& offer,
+                                const std::string& media_security,
+                                const std::string& recording) {
+  RTC_DCHECK(sessions_.find(session_id) == sessions_.end());
+  MediaSecurity security = session_config_.media_security;
+  if (!media_security.empty() &&
+      !Session::ParseMediaSecurity(media_security, &security)) {
+    RTC_LOG(WARNING) << "Invalid media security:" << media_security
+                     << " session:" << session_id;
+    return false;
   }
-  std::string type;
-  std::string json_object;
-
-  rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName, &type);
-  if (!type.empty()) {
-    std::string sdp;
-    if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName,
-                                      &sdp)) {
-      RTC_LOG(WARNING) << "Can't parse received session description message.";
-      return;
-    }
-    RTC_LOG(WARNING) <<"type["<<type<<"]sdp["<< sdp <<"]";
-    webrtc::SdpParseError error;
-    webrtc::SessionDescriptionInterface* session_description(
-        webrtc::CreateSessionDescription(type, sdp, &error));
-    if (!session_description) {
-      RTC_LOG(WARNING) << "Can't parse received session description message. "
-          << "SdpParseError was: " << error.description;
-      return;
-    }
-    RTC_LOG(INFO) << " Received session description :" << message;
-    peer_connection_->SetRemoteDescription(
-        DummySetSessionDescriptionObserver::Create(), session_description);
-    RTC_LOG(INFO) << " remote description set !";
-    if (session_description->type() ==
-        webrtc::SessionDescriptionInterface::kOffer) {
-      peer_connection_->CreateAnswer(this, NULL);
-      RTC_LOG(INFO) << " Answer created !";
-    }
-    return;
-  } else {
-    std::string sdp_mid;
-    int sdp_mlineindex = 0;
-    std::string sdp;
-    if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName,
-                                      &sdp_mid) ||
-        !rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName,
-                                   &sdp_mlineindex) ||
-        !rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp)) {
-      RTC_LOG(WARNING) << "Can't parse received message.";
-      return;
-    }
-    webrtc::SdpParseError error;
-    std::unique_ptr<webrtc::IceCandidateInterface> candidate(
-        webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
-    if (!candidate.get()) {
-      RTC_LOG(WARNING) << "Can't parse received candidate message. "
-          << "SdpParseError was: " << error.description;
-      return;
-    }
-    if (!peer_connection_->AddIceCandidate(candidate.get())) {
-      RTC_LOG(WARNING) << "Failed to apply the received candidate";
-      return;
-    }
-    RTC_LOG(INFO) << " Received candidate :" << message;
-    return;
+  if (!recording.empty() && !SessionRecorder::ValidName(recording)) {
+    RTC_LOG(WARNING) << "Invalid recording name:" << recording
+                     << " session:" << session_id;
+    return false;
   }
+  rtc::scoped_refptr<Session> session =
+      session_pool_.Acquire(session_id, security);
+  session->set_recording_name(recording);
+  sessions_created_++;
+  sessions_.insert(std::make_pair(session_id, session));
+  RTC_LOG(INFO) << "New session:" << session_id << " shard:"
+                << session->shard() << " security:"
+                << Session::MediaSecurityName(security)
+                << " active sessions:" << sessions_.size();
+  session->OnMessageFromPeer(offer);
+  return true;
+}
+
+bool Conductor::OnCandidateFromPeer(int session_id,
+                                    const std::string& candidate) {
+  auto it = sessions_.find(session_id);
+  if (it == sessions_.end()) {
+    RTC_LOG(WARNING) << "Candidate for unknown session:" << session_id;
+    return false;
+  }
+  it->second->OnMessageFromPeer(candidate);
+  return true;
 }
 
 void Conductor::OnMessageSent(int err) {
-   // QueueThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
 }
 
 void Conductor::OnServerConnectionFailure() {
     RTC_LOG(INFO) << "Error Failed to connect to :" << server_;
 }
 
-void Conductor::StartListen(const std::string& ip, int port) {
+std::string Conductor::GetSessionStats() const {
+  char buffer[2048];
+  const PhaseStats* phases[] = {&create_answer_stats_, &gathering_stats_,
+                                &offer_to_answer_stats_, &teardown_stats_};
+  const char* names[] = {"create_answer", "gathering", "offer_to_answer",
+                         "teardown"};
+  const CertificatePool* certificates = session_config_.certificate_pool;
+  size_t len = sprintfn(buffer, sizeof(buffer),
+                        "sessions: %i\n"
+                        "sessions_closing: %i\n"
+                        "sessions_created: %llu\n"
+                        "answers_timed_out: %llu\n"
+                        "session_pool_ready: %i\n"
+                        "session_pool_hits: %llu\n"
+                        "session_pool_misses: %llu\n"
+                        "dtls_certificates: %i\n"
+                        "dtls_certificate_rotations: %llu\n",
+                        static_cast<int>(sessions_.size()),
+                        static_cast<int>(closing_sessions_.size()),
+                        static_cast<unsigned long long>(sessions_created_),
+                        static_cast<unsigned long long>(answers_timed_out_),
+                        static_cast<int>(session_pool_.ready()),
+                        static_cast<unsigned long long>(session_pool_.hits()),
+                        static_cast<unsigned long long>(
+                            session_pool_.misses()),
+                        certificates ?
+                            static_cast<int>(certificates->size()) : 0,
+                        static_cast<unsigned long long>(
+                            certificates ? certificates->rotations() : 0));
+  for (size_t i = 0; i < arraysize(phases); i++)
+    len += FormatPhase(buffer + len, sizeof(buffer) - len, "", names[i],
+                       *phases[i]);
+  for (int reason = 0; reason < SESSION_END_REASON_COUNT; reason++) {
+    const char* name =
+        Session::EndReasonName(static_cast<SessionEndReason>(reason));
+    len += sprintfn(buffer + len, sizeof(buffer) - len,
+                    "sessions_ended_%s: %llu\n", name,
+                    static_cast<unsigned long long>(sessions_ended_[reason]));
+  }
+  for (int mode = 0; mode < MEDIA_SECURITY_COUNT; mode++) {
+    const char* prefix =
+        Session::MediaSecurityName(static_cast<MediaSecurity>(mode));
+    len += FormatPhase(buffer + len, sizeof(buffer) - len, prefix,
+                       "_offer_to_answer", mode_offer_to_answer_stats_[mode]);
+    len += FormatPhase(buffer + len, sizeof(buffer) - len, prefix,
+                       "_answer_to_connected",
+                       mode_answer_to_connected_stats_[mode]);
+  }
+  return std::string(buffer) + factory_pool_->GetStats();
+}
+
+void Conductor::set_session_pool_size(int size) {
+  session_pool_size_ = size;
+}
+
+void Conductor::StartListen(const std::string& ip, int port, int backlog) {
   client_->listen_ip = ip;
-  client_->Listen(ip, port);
+  session_config_.listen_ip = ip;
+  session_pool_.Init(session_pool_size_, session_config_);
+  client_->Listen(ip, port, backlog);
 }
 
 void Conductor::DisconnectFromServer() {
@@ -331,112 +318,70 @@ void Conductor::DisconnectFromServer() {
     client_->SignOut();
 }
 
-void Conductor::ConnectToPeer(int peer_id) {
-  RTC_DCHECK(peer_id_ == -1);
-  RTC_DCHECK(peer_id != -1);
-
-  if (peer_connection_.get()) {
-    RTC_LOG(INFO) << "Error: We only support connecting to one peer at a time";
-    return;
-  }
-
-  if (InitializePeerConnection()) {
-    peer_id_ = peer_id;
-    peer_connection_->CreateOffer(this, NULL);
-  } else {
-    RTC_LOG(INFO) << "Error Failed to initialize PeerConnection";
-  }
+void Conductor::QueueMessage(int peer_id, const std::string& json_object,
+                             PendingMessageType type, int status) {
+  RTC_LOG(INFO) << __FUNCTION__ << " peer:" << peer_id << " type:" << type
+                << " status:" << status;
+  PendingMessage message = {peer_id, type, json_object, status};
+  bool was_empty = pending_messages_.empty();
+  pending_messages_.push_back(std::move(message));
+  if (was_empty)
+    listener_thread_->Post(RTC_FROM_HERE, this, MSG_SEND_PENDING);
 }
 
-void Conductor::AddStreams() {
-  if (active_streams_.find("stream_id_todo_multi_stream") != active_streams_.end())
-    return;  // Already added.
-
-  rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track(
-      peer_connection_factory_->CreateAudioTrack(
-          kAudioLabel, peer_connection_factory_->CreateAudioSource(NULL)));
-
-  rtc::scoped_refptr<webrtc::MediaStreamInterface> stream =
-      peer_connection_factory_->CreateLocalMediaStream("stream_id_todo_multi_stream");
+void Conductor::QueueError(int session_id, int status,
+                           const std::string& reason) {
+  QueueMessage(session_id, reason, PENDING_ERROR, status);
+}
 
-  stream->AddTrack(audio_track);
-  if (!peer_connection_->AddStream(stream)) {
-    RTC_LOG(LS_ERROR) << "Adding stream to PeerConnection failed";
+int Conductor::ErrorStatus(SessionEndReason reason) {
+  switch (reason) {
+    case SESSION_END_INVALID_OFFER:
+      return 400;
+    case SESSION_END_OFFER_TIMEOUT:
+      return 504;
+    default:
+      return 500;
   }
-  typedef std::pair<std::string,
-                    rtc::scoped_refptr<webrtc::MediaStreamInterface> >
-      MediaStreamPair;
-  active_streams_.insert(MediaStreamPair(stream->id(), stream));
 }
 
-void Conductor::DisconnectFromCurrentPeer() {
-  RTC_LOG(INFO) << __FUNCTION__;
-  if (peer_connection_.get()) {
-    client_->SendHangUp(peer_id_);
-    DeletePeerConnection();
-  }
+void Conductor::SendMessage() {
+   while (!pending_messages_.empty() && !client_->IsSendingMessage()) {
+      int peer_id = pending_messages_.front().session_id;
+      PendingMessageType type = pending_messages_.front().type;
+      int status = pending_messages_.front().status;
+      std::string msg = std::move(pending_messages_.front().data);
+      RTC_LOG(INFO) << __FUNCTION__ <<" peer:" << peer_id;
+      RTC_LOG(INFO) << __FUNCTION__ <<" msg:" << msg;
+      pending_messages_.pop_front();
+      switch (type) {
+        case PENDING_REPLY:
+          if (!client_->SendToPeer(peer_id, msg))
+            RTC_LOG(LS_ERROR) << "SendToPeer failed, session:" << peer_id;
+          break;
+        case PENDING_CANDIDATE:
+          client_->SendCandidate(peer_id, msg);
+          break;
+        case PENDING_ERROR:
+          client_->SendErrorToPeer(peer_id, status, msg);
+          break;
+        case PENDING_SESSION_CLOSED:
+          client_->OnSessionClosed(peer_id);
+          break;
+      }
+   }
 }
 
-// Not used since we got rid of GTK, finctionnality need to be moved one by one
-void Conductor::ThreadCallback(int msg_id, void* data) {
-  switch (msg_id) {
-    case PEER_CONNECTION_CLOSED:
-      RTC_LOG(INFO) << "PEER_CONNECTION_CLOSED";
-      DeletePeerConnection();
-      RTC_DCHECK(active_streams_.empty());
-      break;
-    case SEND_MESSAGE_TO_PEER: {
+void Conductor::OnMessage(rtc::Message* msg) {
+  switch (msg->message_id) {
+    case MSG_SEND_PENDING:
+      SendMessage();
       break;
-    }
-    case NEW_STREAM_ADDED: {
-      webrtc::MediaStreamInterface* stream =
-          reinterpret_cast<webrtc::MediaStreamInterface*>(
-          data);
-      webrtc::VideoTrackVector tracks = stream->GetVideoTracks();
-      stream->Release();
+    case MSG_REAP_SESSIONS:
+      ReapSessions(kReapBatchSize);
       break;
-    }
-    case STREAM_REMOVED: {
-      // Remote peer stopped sending a stream.
-      webrtc::MediaStreamInterface* stream =
-          reinterpret_cast<webrtc::MediaStreamInterface*>(
-          data);
-      stream->Release();
-      break;
-    }
     default:
       RTC_NOTREACHED();
       break;
   }
 }
-
-void Conductor::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
-  peer_connection_->SetLocalDescription(
-      DummySetSessionDescriptionObserver::Create(), desc);
-  desc_ = desc;
-  RTC_LOG(INFO) << __FUNCTION__ << " success SDP answer waiting for ICE candidate" ;
-}
-
-void Conductor::OnFailure(const std::string& error) {
-   RTC_LOG(LERROR) << error;
-}
-
-void Conductor::QueueMessage(const std::string& json_object) {
-   RTC_LOG(INFO) << __FUNCTION__ <<" peer:" << peer_id_;
-   std::string* msg = new std::string(json_object);
-   pending_messages_.push_back(msg);
-}
-
-void Conductor::SendMessage() {
-   if (!pending_messages_.empty() && !client_->IsSendingMessage()) {
-      RTC_LOG(INFO) << __FUNCTION__ <<" peer:" << peer_id_;
-      std::string *msg = pending_messages_.front();
-      RTC_LOG(INFO) << __FUNCTION__ <<" msg:" << *msg;
-      pending_messages_.pop_front();
-      if (!client_->SendToPeer(peer_id_, *msg) && peer_id_ != -1) {
-         RTC_LOG(LS_ERROR) << "SendToPeer failed";
-         DisconnectFromServer();
-      }
-      delete msg;
-   }
-}
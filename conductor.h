@@ -12,75 +12,64 @@
 #ifndef PEERCONNECTION_CONDUCTOR_H_
 #define PEERCONNECTION_CONDUCTOR_H_
 
+#include <stdint.h>
+
 #include <deque>
 #include <map>
 #include <memory>
-#include <set>
 #include <string>
+#include <utility>
 
-#include "examples/rtc_gw/audio_device_module.h"
-#include "api/mediastreaminterface.h"
-#include "api/peerconnectioninterface.h"
+#include "examples/rtc_gw/peer_connection_factory_pool.h"
 #include "examples/rtc_gw/peer_connection_listener.h"
+#include "examples/rtc_gw/session.h"
+#include "examples/rtc_gw/session_pool.h"
 
 class Conductor
-  : public webrtc::PeerConnectionObserver,
-    public webrtc::CreateSessionDescriptionObserver,
-    public PeerConnectionListenerObserver {
+  : public SessionObserver,
+    public PeerConnectionListenerObserver,
+    public rtc::MessageHandler {
 
   public:
-  enum CallbackID {
-    MEDIA_CHANNELS_INITIALIZED = 1,
-    PEER_CONNECTION_CLOSED,
-    SEND_MESSAGE_TO_PEER,
-    NEW_STREAM_ADDED,
-    STREAM_REMOVED,
+  enum MessageID {
+    MSG_SEND_PENDING = 1,
+    MSG_REAP_SESSIONS,
   };
 
-  Conductor(PeerConnectionListener* client);
+  Conductor(PeerConnectionListener* client,
+            PeerConnectionFactoryPool* factory_pool,
+            const SessionConfig& session_config);
+  ~Conductor();
 
   bool connection_active() const;
 
   virtual void Close();
 
-  void StartListen(const std::string& server, int port);
+  // Sessions created ahead of the offers, must be set before StartListen().
+  void set_session_pool_size(int size);
+  void StartListen(const std::string& server, int port, int backlog);
   void DisconnectFromServer();
-  void ConnectToPeer(int peer_id);
-  void DisconnectFromCurrentPeer();
-  void ThreadCallback(int msg_id, void* data);
 
-  // Send a message from the message queue if there is any
+  // Send the messages from the message queue if there are any
   void SendMessage();
 
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
  protected:
-  rtc::Thread *worker_and_network_thread_;
-  rtc::Thread *signaling_thread_;
-  webrtc::AudioDeviceModule *audio_device_;
-  int OnIceCandidateCount_;
-  webrtc::SessionDescriptionInterface* desc_;
-  ~Conductor();
-  bool InitializePeerConnection();
-  bool CreatePeerConnection(bool dtls);
-  void DeletePeerConnection();
-  void EnsureStreamingUI();
-  void AddStreams();
-
-  // PeerConnectionObserver implementation.
-  void OnSignalingChange(
-      webrtc::PeerConnectionInterface::SignalingState new_state) override{};
-  void OnAddStream(
-      rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) override;
-  void OnRemoveStream(
-      rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) override;
-  void OnDataChannel(
-      rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
-  void OnRenegotiationNeeded() override {}
-  void OnIceConnectionChange(
-      webrtc::PeerConnectionInterface::IceConnectionState new_state) override{};
-  void OnIceGatheringChange(
-      webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
-  void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
-  void OnIceConnectionReceivingChange(bool receiving) override {}
+  // Detaches the session at once, its PeerConnection is torn down later
+  // by ReapSessions().
+  void CloseSession(int session_id);
+  void CloseAllSessions();
+  // Tears down up to |max| closed sessions.
+  void ReapSessions(size_t max);
+
+  // SessionObserver implementation.
+  void OnSessionAnswer(int session_id, const std::string& sdp) override;
+  void OnSessionCandidate(int session_id,
+                          const std::string& candidate) override;
+  void OnSessionConnected(int session_id) override;
+  void OnSessionEnded(int session_id, SessionEndReason reason) override;
 
   // PeerConnectionListenerObserver implementation.
   void OnSignedIn() override;
@@ -88,26 +77,80 @@ class Conductor
   void OnPeerConnected(int id, const std::string& name) override;
   void OnPeerDisconnected(int id) override;
   void OnMessageFromPeer(int peer_id, const std::string& message) override;
+  bool OnOfferFromPeer(int session_id, const std::string& offer,
+                       const std::string& media_security,
+                       const std::string& recording) override;
+  bool OnCandidateFromPeer(int session_id,
+                           const std::string& candidate) override;
   void OnMessageSent(int err) override;
   void OnServerConnectionFailure() override;
-
-  // CreateSessionDescriptionObserver implementation.
-  void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
-  void OnFailure(const std::string& error) override;
+  std::string GetSessionStats() const override;
 
  protected:
-  int peer_id_;
-  // Queue a message to the remote peer.
-  void QueueMessage(const std::string& json_object);
+  // Count, sum and max of a call setup phase in milliseconds.
+  struct PhaseStats {
+    PhaseStats() : count(0), total_ms(0), max_ms(0) {}
+    void Add(int64_t ms);
+    uint64_t count;
+    int64_t total_ms;
+    int64_t max_ms;
+  };
+  static size_t FormatPhase(char* buffer, size_t size, const char* prefix,
+                            const char* name, const PhaseStats& phase);
+
+  enum PendingMessageType {
+    // Answers the pending request of the session.
+    PENDING_REPLY,
+    // Local candidate, empty at the end of gathering.
+    PENDING_CANDIDATE,
+    // The offer failed, |data| is the reason.
+    PENDING_ERROR,
+    // The session is gone, the listener forgets it.
+    PENDING_SESSION_CLOSED,
+  };
+  struct PendingMessage {
+    int session_id;
+    PendingMessageType type;
+    std::string data;
+    // HTTP status of an error.
+    int status;
+  };
+
+  // Queue a message to the remote peer and wake up the listener thread.
+  // Messages of a session leave in order whatever their type. |status| is
+  // the HTTP status of a PENDING_ERROR.
+  void QueueMessage(int peer_id, const std::string& json_object,
+                    PendingMessageType type = PENDING_REPLY, int status = 0);
+  void QueueError(int session_id, int status, const std::string& reason);
+  // HTTP status of an offer failed for |reason|.
+  static int ErrorStatus(SessionEndReason reason);
 
-  rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
-  rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
-      peer_connection_factory_;
   PeerConnectionListener* client_;
-  std::deque<std::string*> pending_messages_;
-  std::map<std::string, rtc::scoped_refptr<webrtc::MediaStreamInterface> >
-      active_streams_;
+  // Thread running the listener, pending messages are sent from it.
+  rtc::Thread* listener_thread_;
+  PeerConnectionFactoryPool* factory_pool_;
+  SessionConfig session_config_;
+  SessionPool session_pool_;
+  int session_pool_size_;
+  std::deque<PendingMessage> pending_messages_;
+  // Active calls keyed by the session id generated by the listener.
+  std::map<int, rtc::scoped_refptr<Session> > sessions_;
+  // Closed sessions waiting for their PeerConnection teardown.
+  std::deque<rtc::scoped_refptr<Session> > closing_sessions_;
   std::string server_;
+  uint64_t sessions_created_;
+  uint64_t answers_timed_out_;
+  // Sessions torn down without a BYE, per reason.
+  uint64_t sessions_ended_[SESSION_END_REASON_COUNT];
+  // Offer received to answer created, answer created to answer sent.
+  PhaseStats create_answer_stats_;
+  PhaseStats gathering_stats_;
+  PhaseStats offer_to_answer_stats_;
+  PhaseStats teardown_stats_;
+  // Per media security mode, offer received to answer sent and answer sent
+  // to ICE connected.
+  PhaseStats mode_offer_to_answer_stats_[MEDIA_SECURITY_COUNT];
+  PhaseStats mode_answer_to_connected_stats_[MEDIA_SECURITY_COUNT];
 };
 
 #endif  // PEERCONNECTION_CONDUCTOR_H_
@@ -23,5 +23,74 @@ extern const uint16_t kDefaultServerPort;  // From defaults.[h|cc]
 DEFINE_bool(help, false, "Prints this message");
 DEFINE_int(port, kDefaultServerPort, "The port on which the server is listening.");
 DEFINE_string(listen, "localhost", "The IP to listen on.");
+DEFINE_int(listen_backlog, 128,
+           "Length of the accept queue, capped by net.core.somaxconn.");
+DEFINE_int(keepalive_timeout_ms, 30000,
+           "Idle HTTP keep-alive connections are closed after this delay, "
+           "0 disables keep-alive.");
+DEFINE_int(network_threads, 1, "Number of network threads (ICE, SRTP).");
+DEFINE_int(worker_threads, 1, "Number of worker threads (jitter buffer, codecs).");
+DEFINE_int(media_clock_threads, 1,
+           "Realtime threads pacing the audio of every session, 10 ms "
+           "frames.");
+DEFINE_int(media_clock_catchup_ms, 50,
+           "A media clock thread late by up to this delay runs the missed "
+           "10 ms frames back to back, later ones are skipped.");
+DEFINE_string(session_placement, "round_robin",
+              "How new sessions are spread on the threads: round_robin or least_loaded.");
+DEFINE_string(ice_gathering, "listen_ip",
+              "When the answer is sent: host (first host candidate), "
+              "listen_ip (first candidate on --listen) or complete "
+              "(gathering done).");
+DEFINE_int(ice_gathering_timeout_ms, 0,
+           "Send the answer after this delay whatever was gathered, "
+           "0 waits as long as it takes.");
+
+DEFINE_bool(ice_lite, false,
+            "Gather host candidates on the listen IP only, without STUN, "
+            "and advertise ICE-lite in the answer.");
+DEFINE_int(min_port, 0, "Lowest local UDP port for media, 0 for any.");
+DEFINE_int(max_port, 0, "Highest local UDP port for media, 0 for any.");
+DEFINE_int(session_pool_size, 0,
+           "Sessions created ahead of the offers so an offer only waits for "
+           "its answer, 0 creates them on demand.");
+DEFINE_int(ice_candidate_pool_size, 0,
+           "ICE candidates gathered before the offer by each session, "
+           "useful with --session_pool_size.");
+DEFINE_int(dtls_certificates, 1,
+           "DTLS certificates shared by the sessions, 0 generates one per "
+           "session.");
+DEFINE_int(dtls_certificate_rotation_s, 86400,
+           "Replace the oldest DTLS certificate after this delay, up to "
+           "2000000 s and one year over --dtls_certificates, the life of a "
+           "certificate. 0 never rotates.");
+DEFINE_string(dtls_certificate_file, "",
+              "PEM certificate used instead of generated ones, read again at "
+              "each rotation.");
+DEFINE_string(dtls_private_key_file, "",
+              "PEM private key of --dtls_certificate_file.");
+DEFINE_string(media_security, "dtls",
+              "Media keying when the offer does not ask for one: dtls "
+              "(DTLS-SRTP) or sdes (keys in the SDP, trusted networks only).");
+DEFINE_int(offer_timeout_ms, 10000,
+           "Fail an offer still unanswered after this delay with a 504, 0 "
+           "waits as long as it takes.");
+DEFINE_int(ice_disconnected_timeout_ms, 10000,
+           "End a session whose ICE stays disconnected this long, 0 waits "
+           "for ICE to fail.");
+DEFINE_int(media_timeout_ms, 30000,
+           "End a session that received nothing on its media transport this "
+           "long, 0 disables it.");
+DEFINE_int(max_call_duration_s, 0,
+           "End a session this long after its answer, up to 2000000 s, 0 "
+           "for no limit.");
+DEFINE_string(recording, "mixed",
+              "What is recorded: mixed (the playout mix of each thread in "
+              "recording.raw), session (the remote audio of each session in "
+              "its own file), both or none.");
+DEFINE_string(recording_dir, "/audio",
+              "Directory of the session recordings, named session_<id>.raw "
+              "or session_<id>_<name>.raw after the \"recording\" parameter "
+              "of the offer, existing files are kept.");
 
 #endif  // RTC_GW_FLAGDEFS_H_
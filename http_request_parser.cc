@@ -0,0 +1,194 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/http_request_parser.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "rtc_base/logging.h"
+
+const size_t HttpRequestParser::kMaxHeaderSize;
+const size_t HttpRequestParser::kMaxBodySize;
+
+namespace {
+
+std::string ToLower(const std::string& str) {
+  std::string lower(str);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  return lower;
+}
+
+std::string Trim(const std::string& str) {
+  size_t begin = str.find_first_not_of(" \t");
+  if (begin == std::string::npos)
+    return "";
+  size_t end = str.find_last_not_of(" \t");
+  return str.substr(begin, end - begin + 1);
+}
+
+// Bytes of |data| up to the end of the empty line closing the headers,
+// npos if it is not there. The line may start in |buffered|.
+size_t FindEndOfHeaders(const std::string& buffered, const char* data,
+                        size_t len) {
+  static const char kEndOfHeaders[] = "\r\n\r\n";
+  const size_t kLength = sizeof(kEndOfHeaders) - 1;
+  size_t tail = std::min(buffered.size(), kLength - 1);
+  std::string seam = buffered.substr(buffered.size() - tail);
+  seam.append(data, std::min(len, kLength - 1));
+  size_t pos = seam.find(kEndOfHeaders);
+  if (pos != std::string::npos)
+    return pos + kLength - tail;
+  const char* end = data + len;
+  const char* found = std::search(data, end, kEndOfHeaders,
+                                  kEndOfHeaders + kLength);
+  if (found == end)
+    return std::string::npos;
+  return found - data + kLength;
+}
+
+}  // namespace
+
+HttpRequestParser::HttpRequestParser() {
+  Reset();
+}
+
+void HttpRequestParser::Reset() {
+  state_ = STATE_HEADERS;
+  header_data_.clear();
+  method_.clear();
+  path_.clear();
+  version_.clear();
+  headers_.clear();
+  content_length_ = 0;
+  body_.clear();
+}
+
+size_t HttpRequestParser::Parse(const char* data, size_t len) {
+  size_t used = 0;
+  if (state_ == STATE_HEADERS) {
+    // Only the headers are buffered, what follows them is body or the next
+    // request.
+    size_t header_len = FindEndOfHeaders(header_data_, data, len);
+    used = header_len == std::string::npos ? len : header_len;
+    if (header_data_.size() + used > kMaxHeaderSize) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": headers too large";
+      state_ = STATE_ERROR;
+      return used;
+    }
+    header_data_.append(data, used);
+    if (header_len == std::string::npos)
+      return used;
+    if (!ParseHeaders()) {
+      state_ = STATE_ERROR;
+      return used;
+    }
+    if (content_length_ == 0) {
+      state_ = STATE_COMPLETE;
+      return used;
+    }
+    body_.reserve(content_length_);
+    state_ = STATE_BODY;
+  }
+
+  if (state_ == STATE_BODY) {
+    size_t take = std::min(content_length_ - body_.size(), len - used);
+    body_.append(data + used, take);
+    used += take;
+    if (body_.size() == content_length_)
+      state_ = STATE_COMPLETE;
+  }
+  return used;
+}
+
+bool HttpRequestParser::ParseHeaders() {
+  size_t eol = header_data_.find("\r\n");
+  std::string request_line = header_data_.substr(0, eol);
+  size_t sp1 = request_line.find(' ');
+  size_t sp2 = request_line.rfind(' ');
+  if (sp1 == std::string::npos || sp2 == sp1) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": bad request line:" << request_line;
+    return false;
+  }
+  method_ = request_line.substr(0, sp1);
+  path_ = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+  version_ = request_line.substr(sp2 + 1);
+  if (version_.compare(0, 5, "HTTP/") != 0) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": bad version:" << version_;
+    return false;
+  }
+
+  size_t pos = eol + 2;
+  while (pos < header_data_.size()) {
+    eol = header_data_.find("\r\n", pos);
+    if (eol == pos)
+      break;  // Empty line, end of headers.
+    size_t colon = header_data_.find(':', pos);
+    if (colon != std::string::npos && colon < eol) {
+      headers_[ToLower(header_data_.substr(pos, colon - pos))] =
+          Trim(header_data_.substr(colon + 1, eol - colon - 1));
+    }
+    pos = eol + 2;
+  }
+  // The raw headers are not needed anymore.
+  header_data_.clear();
+
+  std::string value;
+  if (GetHeader("transfer-encoding", &value) && value != "identity") {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": unsupported transfer encoding:"
+                      << value;
+    return false;
+  }
+  if (GetHeader("content-length", &value)) {
+    content_length_ = strtoul(value.c_str(), NULL, 10);
+    if (content_length_ > kMaxBodySize) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": body too large:"
+                        << content_length_;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HttpRequestParser::GetHeader(const std::string& name,
+                                  std::string* value) const {
+  auto it = headers_.find(ToLower(name));
+  if (it == headers_.end())
+    return false;
+  *value = it->second;
+  return true;
+}
+
+bool HttpRequestParser::GetQueryParameter(const std::string& name,
+                                          std::string* value) const {
+  size_t pos = path_.find('?');
+  while (pos != std::string::npos) {
+    pos++;
+    size_t end = path_.find('&', pos);
+    size_t eq = path_.find('=', pos);
+    if (eq != std::string::npos && eq < end &&
+        path_.compare(pos, eq - pos, name) == 0) {
+      *value = path_.substr(eq + 1, end == std::string::npos ?
+                                    std::string::npos : end - eq - 1);
+      return true;
+    }
+    pos = end;
+  }
+  return false;
+}
+
+bool HttpRequestParser::PathIs(const char* prefix) const {
+  size_t len = strlen(prefix);
+  return path_.compare(0, len, prefix) == 0 &&
+         (path_.size() == len || path_[len] == '?');
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_HTTP_REQUEST_PARSER_H_
+#define PEERCONNECTION_HTTP_REQUEST_PARSER_H_
+
+#include <map>
+#include <string>
+
+// Resumable HTTP/1.1 request parser. Bytes are fed as they are read from the
+// socket, the search for the end of the headers resumes where the previous
+// read stopped, only the bytes up to the empty line are buffered as headers,
+// they are parsed once and what follows goes straight to the body, so a
+// request split over many segments is scanned only once.
+class HttpRequestParser {
+ public:
+  enum State {
+    STATE_HEADERS,
+    STATE_BODY,
+    STATE_COMPLETE,
+    STATE_ERROR,
+  };
+
+  // Offers are a few KB, anything much bigger is not a signaling request.
+  static const size_t kMaxHeaderSize = 16 * 1024;
+  static const size_t kMaxBodySize = 1024 * 1024;
+
+  HttpRequestParser();
+
+  // Consumes bytes up to the end of the current request and returns how many
+  // were used, the rest belongs to the next request on the connection.
+  size_t Parse(const char* data, size_t len);
+  // Forgets the current request, to be called once it has been handled.
+  void Reset();
+
+  State state() const { return state_; }
+  bool complete() const { return state_ == STATE_COMPLETE; }
+  bool error() const { return state_ == STATE_ERROR; }
+
+  const std::string& method() const { return method_; }
+  // Request target including the query string.
+  const std::string& path() const { return path_; }
+  const std::string& version() const { return version_; }
+  const std::string& body() const { return body_; }
+  size_t content_length() const { return content_length_; }
+
+  // Header names are matched case-insensitively.
+  bool GetHeader(const std::string& name, std::string* value) const;
+  // Returns the value of "name=" in the query string.
+  bool GetQueryParameter(const std::string& name, std::string* value) const;
+  // True if the path is |prefix| optionally followed by a query string.
+  bool PathIs(const char* prefix) const;
+
+ protected:
+  bool ParseHeaders();
+
+  State state_;
+  // Headers received so far, up to their empty line.
+  std::string header_data_;
+  std::string method_;
+  std::string path_;
+  std::string version_;
+  std::map<std::string, std::string> headers_;
+  size_t content_length_;
+  std::string body_;
+};
+
+#endif  // PEERCONNECTION_HTTP_REQUEST_PARSER_H_
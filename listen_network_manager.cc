@@ -0,0 +1,62 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/listen_network_manager.h"
+
+#include <sys/socket.h>
+
+#include "rtc_base/logging.h"
+#include "rtc_base/thread.h"
+
+ListenNetworkManager::ListenNetworkManager(const rtc::IPAddress& ip)
+  : ip_(ip),
+    start_count_(0),
+    sent_first_update_(false) {
+}
+
+void ListenNetworkManager::StartUpdating() {
+  // Like the BasicNetworkManager, the networks are signaled asynchronously
+  // on the calling thread, to every allocator session of the thread.
+  ++start_count_;
+  if (start_count_ == 1) {
+    sent_first_update_ = false;
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this, MSG_UPDATE_NETWORKS);
+  } else if (sent_first_update_) {
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this, MSG_SIGNAL_NETWORKS);
+  }
+}
+
+void ListenNetworkManager::StopUpdating() {
+  --start_count_;
+}
+
+void ListenNetworkManager::OnMessage(rtc::Message* msg) {
+  if (msg->message_id == MSG_SIGNAL_NETWORKS) {
+    SignalNetworksChanged();
+    return;
+  }
+  if (start_count_ == 0)
+    return;
+  int prefix_length = ip_.family() == AF_INET6 ? 128 : 32;
+  rtc::Network* network = new rtc::Network(
+      "rtc_gw_listen", "listen address", rtc::TruncateIP(ip_, prefix_length),
+      prefix_length, rtc::ADAPTER_TYPE_UNKNOWN);
+  network->AddIP(rtc::InterfaceAddress(ip_));
+  NetworkList networks;
+  networks.push_back(network);
+  // Takes ownership of |network|.
+  bool changed = false;
+  MergeNetworkList(networks, &changed);
+  if (changed || !sent_first_update_) {
+    RTC_LOG(INFO) << __FUNCTION__ << " gathering on:" << ip_.ToString();
+    SignalNetworksChanged();
+    sent_first_update_ = true;
+  }
+}
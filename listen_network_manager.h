@@ -0,0 +1,45 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_LISTEN_NETWORK_MANAGER_H_
+#define PEERCONNECTION_LISTEN_NETWORK_MANAGER_H_
+
+#include "rtc_base/ipaddress.h"
+#include "rtc_base/messagehandler.h"
+#include "rtc_base/network.h"
+
+// A NetworkManager exposing a single network holding the listen address,
+// so the port allocators of ICE-lite sessions gather on that address only
+// whatever interface carries the default route. Used from one network
+// thread, like the NetworkManager of a factory.
+class ListenNetworkManager : public rtc::NetworkManagerBase,
+                             public rtc::MessageHandler {
+ public:
+  enum MessageID {
+    MSG_UPDATE_NETWORKS = 1,
+    MSG_SIGNAL_NETWORKS,
+  };
+
+  explicit ListenNetworkManager(const rtc::IPAddress& ip);
+
+  // NetworkManager implementation.
+  void StartUpdating() override;
+  void StopUpdating() override;
+
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
+ protected:
+  rtc::IPAddress ip_;
+  int start_count_;
+  bool sent_first_update_;
+};
+
+#endif  // PEERCONNECTION_LISTEN_NETWORK_MANAGER_H_
@@ -10,36 +10,18 @@
  */
 
 
+#include "examples/rtc_gw/certificate_pool.h"
 #include "examples/rtc_gw/conductor.h"
 #include "examples/rtc_gw/flagdefs.h"
+#include "examples/rtc_gw/peer_connection_factory_pool.h"
 #include "examples/rtc_gw/peer_connection_listener.h"
+#include "examples/rtc_gw/session_recorder.h"
+
+#include <memory>
 
 #include "rtc_base/ssladapter.h"
 #include "rtc_base/thread.h"
 
-class CustomSocketServer : public rtc::PhysicalSocketServer {
- public:
-  explicit CustomSocketServer() : conductor_(NULL), client_(NULL) {}
-  virtual ~CustomSocketServer() {}
-
-  void SetMessageQueue(rtc::MessageQueue* queue) override {
-    message_queue_ = queue;
-  }
-
-  void set_client(PeerConnectionListener* client) { client_ = client; }
-  void set_conductor(Conductor* conductor) { conductor_ = conductor; }
-
-  virtual bool Wait(int cms, bool process_io) override {
-    conductor_->SendMessage();
-    return rtc::PhysicalSocketServer::Wait(10/*cms == -1 ? 1 : cms*/, process_io);
-  }
-
- protected:
-  rtc::MessageQueue* message_queue_;
-  Conductor* conductor_;
-  PeerConnectionListener* client_;
-};
-
 int main(int argc, char* argv[]) {
   printf("starting ...\n ");
 
@@ -57,19 +39,156 @@ int main(int argc, char* argv[]) {
     return -1;
   }
 
-  printf("listening[%s]\n", FLAG_listen);
-  CustomSocketServer socket_server;
-  rtc::AutoSocketServerThread thread(&socket_server);
+  if (FLAG_listen_backlog < 1) {
+    printf("Error: %i is not a valid listen backlog.\n", FLAG_listen_backlog);
+    return -1;
+  }
+
+  PeerConnectionFactoryPool::Placement placement;
+  if (!PeerConnectionFactoryPool::ParsePlacement(FLAG_session_placement,
+                                                 &placement)) {
+    printf("Error: %s is not a valid session placement.\n",
+           FLAG_session_placement);
+    return -1;
+  }
+
+  SessionConfig session_config;
+  if (!Session::ParseIceGatheringPolicy(FLAG_ice_gathering,
+                                        &session_config.ice_gathering)) {
+    printf("Error: %s is not a valid ICE gathering policy.\n",
+           FLAG_ice_gathering);
+    return -1;
+  }
+  if (FLAG_ice_gathering_timeout_ms < 0) {
+    printf("Error: %i is not a valid ICE gathering timeout.\n",
+           FLAG_ice_gathering_timeout_ms);
+    return -1;
+  }
+  session_config.ice_gathering_timeout_ms = FLAG_ice_gathering_timeout_ms;
+
+  if (FLAG_min_port < 0 || FLAG_max_port > 65535 ||
+      FLAG_min_port > FLAG_max_port) {
+    printf("Error: [%i, %i] is not a valid port range.\n", FLAG_min_port,
+           FLAG_max_port);
+    return -1;
+  }
+  if (FLAG_session_pool_size < 0 || FLAG_ice_candidate_pool_size < 0) {
+    printf("Error: pool sizes can not be negative.\n");
+    return -1;
+  }
+  session_config.ice_candidate_pool_size = FLAG_ice_candidate_pool_size;
+  if (FLAG_dtls_certificates < 0 || FLAG_dtls_certificate_rotation_s < 0 ||
+      FLAG_dtls_certificate_rotation_s > CertificatePool::kMaxRotationS ||
+      static_cast<int64_t>(FLAG_dtls_certificates) *
+              FLAG_dtls_certificate_rotation_s >
+          CertificatePool::kMaxCycleS) {
+    printf("Error: invalid DTLS certificate pool settings.\n");
+    return -1;
+  }
+  if ((FLAG_dtls_certificate_file[0] == '\0') !=
+      (FLAG_dtls_private_key_file[0] == '\0')) {
+    printf("Error: --dtls_certificate_file and --dtls_private_key_file go "
+           "together.\n");
+    return -1;
+  }
+  if (!Session::ParseMediaSecurity(FLAG_media_security,
+                                   &session_config.media_security)) {
+    printf("Error: %s is not a valid media security.\n", FLAG_media_security);
+    return -1;
+  }
+  if (FLAG_offer_timeout_ms < 0 || FLAG_ice_disconnected_timeout_ms < 0 ||
+      FLAG_media_timeout_ms < 0 || FLAG_max_call_duration_s < 0) {
+    printf("Error: session timeouts can not be negative.\n");
+    return -1;
+  }
+  if (FLAG_max_call_duration_s > Session::kMaxDurationS) {
+    printf("Error: --max_call_duration_s is at most %i.\n",
+           Session::kMaxDurationS);
+    return -1;
+  }
+  session_config.offer_timeout_ms = FLAG_offer_timeout_ms;
+  session_config.ice_disconnected_timeout_ms = FLAG_ice_disconnected_timeout_ms;
+  session_config.media_timeout_ms = FLAG_media_timeout_ms;
+  session_config.max_duration_s = FLAG_max_call_duration_s;
+  RecordingMode recording;
+  if (!SessionRecorder::ParseMode(FLAG_recording, &recording)) {
+    printf("Error: %s is not a valid recording mode.\n", FLAG_recording);
+    return -1;
+  }
+  session_config.recording_dir = FLAG_recording_dir;
+  session_config.ice_lite = FLAG_ice_lite;
+  session_config.min_port = FLAG_min_port;
+  session_config.max_port = FLAG_max_port;
 
+  printf("listening[%s]\n", FLAG_listen);
+  rtc::AutoThread main_thread;
   rtc::InitializeSSL();
-  // Must be constructed after we set the socketserver.
-  PeerConnectionListener client;
-  rtc::scoped_refptr<Conductor> conductor(new rtc::RefCountedObject<Conductor>(&client));
-  socket_server.set_client(&client);
-  socket_server.set_conductor(conductor);
-  conductor->StartListen(FLAG_listen, FLAG_port);
-  thread.Run();
 
+  // The HTTP listener, the Conductor and the PeerConnection signaling
+  // callbacks all run on this thread, media runs on the factory pool threads.
+  std::unique_ptr<rtc::Thread> signaling_thread =
+      rtc::Thread::CreateWithSocketServer();
+  signaling_thread->SetName("rtc_gw_signaling", nullptr);
+  signaling_thread->Start();
+
+  // The factories, their threads and audio devices are shared by every
+  // session, they are created once here instead of on every offer.
+  PeerConnectionFactoryPool factory_pool(signaling_thread.get());
+  bool record_playout =
+      recording == RECORDING_MIXED || recording == RECORDING_BOTH;
+  if (!factory_pool.Init(FLAG_network_threads, FLAG_worker_threads,
+                         FLAG_media_clock_threads, FLAG_media_clock_catchup_ms,
+                         record_playout, placement)) {
+    signaling_thread->Stop();
+    rtc::CleanupSSL();
+    return -1;
+  }
+  // ICE-lite only advertises the listen IP, gathering is bound to it.
+  if (FLAG_ice_lite && !factory_pool.BindNetworks(FLAG_listen)) {
+    printf("Error: --ice_lite needs a specific --listen IP.\n");
+    factory_pool.Terminate();
+    signaling_thread->Stop();
+    rtc::CleanupSSL();
+    return -1;
+  }
+  if (recording == RECORDING_SESSION || recording == RECORDING_BOTH)
+    session_config.recording_writers = factory_pool.audio_writers();
+
+  // Generated before the first offer instead of by each PeerConnection.
+  CertificatePool certificate_pool(signaling_thread.get());
+  if (!certificate_pool.Init(FLAG_dtls_certificates,
+                             FLAG_dtls_certificate_rotation_s,
+                             FLAG_dtls_certificate_file,
+                             FLAG_dtls_private_key_file)) {
+    factory_pool.Terminate();
+    signaling_thread->Stop();
+    rtc::CleanupSSL();
+    return -1;
+  }
+  session_config.certificate_pool = &certificate_pool;
+
+  // Must be constructed on the signaling thread, it owns their sockets.
+  std::unique_ptr<PeerConnectionListener> client;
+  std::unique_ptr<Conductor> conductor;
+  signaling_thread->Invoke<void>(RTC_FROM_HERE, [&] {
+    client.reset(new PeerConnectionListener());
+    client->set_keepalive_timeout_ms(FLAG_keepalive_timeout_ms);
+    conductor.reset(new Conductor(client.get(), &factory_pool,
+                                  session_config));
+    conductor->set_session_pool_size(FLAG_session_pool_size);
+    conductor->StartListen(FLAG_listen, FLAG_port, FLAG_listen_backlog);
+  });
+
+  main_thread.Run();
+
+  signaling_thread->Invoke<void>(RTC_FROM_HERE, [&] {
+    conductor->Close();
+    conductor.reset();
+    client.reset();
+  });
+  certificate_pool.Terminate();
+  factory_pool.Terminate();
+  signaling_thread->Stop();
   rtc::CleanupSSL();
   return 0;
 }
@@ -0,0 +1,239 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/media_clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/stringutils.h"
+#include "rtc_base/timeutils.h"
+#include "system_wrappers/include/sleep.h"
+
+using rtc::sprintfn;
+
+namespace {
+
+const int64_t kTickIntervalNs = 10 * rtc::kNumNanosecsPerMillisec;
+
+int64_t MonotonicNanos() {
+#if defined(WEBRTC_LINUX)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * rtc::kNumNanosecsPerSec +
+         ts.tv_nsec;
+#else
+  return rtc::TimeNanos();
+#endif
+}
+
+// Sleeps until an absolute MonotonicNanos() deadline, unlike a relative
+// sleep the time spent before the call is not added to the wait.
+void SleepUntil(int64_t deadline_ns) {
+#if defined(WEBRTC_LINUX)
+  struct timespec ts;
+  ts.tv_sec = deadline_ns / rtc::kNumNanosecsPerSec;
+  ts.tv_nsec = deadline_ns % rtc::kNumNanosecsPerSec;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+         EINTR) {
+  }
+#else
+  int64_t wait_ns = deadline_ns - MonotonicNanos();
+  if (wait_ns > 0)
+    webrtc::SleepMs(static_cast<int>(wait_ns / rtc::kNumNanosecsPerMillisec));
+#endif
+}
+
+}  // namespace
+
+const int64_t MediaClock::kLatenessBucketUs[] = {100, 500, 1000, 2000, 5000,
+                                                 10000};
+
+MediaClock::TickStats::TickStats()
+  : ticks(0),
+    caught_up(0),
+    skipped(0),
+    max_lateness_us(0) {
+  for (int i = 0; i < kLatenessBuckets; i++)
+    lateness[i] = 0;
+}
+
+MediaClock::Ticker::Ticker()
+  : clock(NULL),
+    next_tick_ns(0) {
+}
+
+MediaClock::MediaClock()
+  : max_catchup_ns_(0),
+    running_(false) {
+}
+
+MediaClock::~MediaClock() {
+  Stop();
+}
+
+bool MediaClock::Start(int threads, int max_catchup_ms) {
+  RTC_DCHECK(!running_);
+  if (threads < 1 || max_catchup_ms < 0) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": invalid thread count:" << threads
+                      << " or catch-up:" << max_catchup_ms;
+    return false;
+  }
+  max_catchup_ns_ = max_catchup_ms * rtc::kNumNanosecsPerMillisec;
+  running_ = true;
+  for (int i = 0; i < threads; i++) {
+    std::unique_ptr<Ticker> ticker(new Ticker());
+    char name[64];
+    sprintfn(name, sizeof(name), "rtc_gw_media_clock_%i", i);
+    ticker->clock = this;
+    ticker->thread.reset(
+        new rtc::PlatformThread(TickerThreadFunc, ticker.get(), name));
+    ticker->thread->Start();
+    ticker->thread->SetPriority(rtc::kRealtimePriority);
+    tickers_.push_back(std::move(ticker));
+  }
+  RTC_LOG(INFO) << __FUNCTION__ << " threads:" << threads << " catch-up:"
+                << max_catchup_ms << "ms";
+  return true;
+}
+
+void MediaClock::Stop() {
+  if (!running_)
+    return;
+  running_ = false;
+  for (auto& ticker : tickers_) {
+    ticker->thread->Stop();
+    RTC_DCHECK(ticker->clients.empty());
+  }
+  tickers_.clear();
+}
+
+void MediaClock::AddClient(MediaClockClient* client) {
+  RTC_DCHECK(!tickers_.empty());
+  Ticker* least_loaded = NULL;
+  size_t least_clients = 0;
+  for (auto& ticker : tickers_) {
+    rtc::CritScope lock(&ticker->lock);
+    auto& clients = ticker->clients;
+    if (std::find(clients.begin(), clients.end(), client) != clients.end())
+      return;
+    if (!least_loaded || clients.size() < least_clients) {
+      least_loaded = ticker.get();
+      least_clients = clients.size();
+    }
+  }
+  rtc::CritScope lock(&least_loaded->lock);
+  least_loaded->clients.push_back(client);
+}
+
+void MediaClock::RemoveClient(MediaClockClient* client) {
+  for (auto& ticker : tickers_) {
+    rtc::CritScope lock(&ticker->lock);
+    auto& clients = ticker->clients;
+    auto it = std::find(clients.begin(), clients.end(), client);
+    if (it != clients.end()) {
+      clients.erase(it);
+      return;
+    }
+  }
+}
+
+bool MediaClock::TickerThreadFunc(void* ticker) {
+  Ticker* self = static_cast<Ticker*>(ticker);
+  return self->clock->Tick(self);
+}
+
+bool MediaClock::Tick(Ticker* ticker) {
+  if (!running_)
+    return false;
+  int64_t now = MonotonicNanos();
+  if (ticker->next_tick_ns == 0)
+    ticker->next_tick_ns = now;
+  if (now < ticker->next_tick_ns) {
+    SleepUntil(ticker->next_tick_ns);
+    return true;
+  }
+
+  int64_t lateness_ns = now - ticker->next_tick_ns;
+  int64_t missed = lateness_ns / kTickIntervalNs;
+  if (missed > 0 && lateness_ns > max_catchup_ns_) {
+    // Too late to make up for, the missed frames are dropped.
+    ticker->next_tick_ns += missed * kTickIntervalNs;
+  }
+  {
+    rtc::CritScope lock(&ticker->stats_lock);
+    TickStats& stats = ticker->stats;
+    int64_t lateness_us = lateness_ns / rtc::kNumNanosecsPerMicrosec;
+    int bucket = 0;
+    while (bucket < kLatenessBuckets - 1 &&
+           lateness_us > kLatenessBucketUs[bucket])
+      bucket++;
+    stats.lateness[bucket]++;
+    stats.max_lateness_us = std::max(stats.max_lateness_us, lateness_us);
+    stats.ticks++;
+    if (missed > 0 && lateness_ns > max_catchup_ns_)
+      stats.skipped += missed;
+    else if (missed > 0)
+      stats.caught_up++;
+  }
+
+  {
+    rtc::CritScope lock(&ticker->lock);
+    for (MediaClockClient* client : ticker->clients)
+      client->OnMediaTick();
+  }
+  // From the deadline, not from now, the batch duration and the wakeup
+  // latency do not accumulate. Missed ticks still due run at once.
+  ticker->next_tick_ns += kTickIntervalNs;
+  if (ticker->next_tick_ns > MonotonicNanos())
+    SleepUntil(ticker->next_tick_ns);
+  return true;
+}
+
+std::string MediaClock::GetStats() const {
+  TickStats total;
+  for (auto& ticker : tickers_) {
+    rtc::CritScope lock(&ticker->stats_lock);
+    const TickStats& stats = ticker->stats;
+    total.ticks += stats.ticks;
+    total.caught_up += stats.caught_up;
+    total.skipped += stats.skipped;
+    total.max_lateness_us = std::max(total.max_lateness_us,
+                                     stats.max_lateness_us);
+    for (int i = 0; i < kLatenessBuckets; i++)
+      total.lateness[i] += stats.lateness[i];
+  }
+  char buffer[1024];
+  size_t len = sprintfn(buffer, sizeof(buffer),
+                        "media_clock_ticks: %llu\n"
+                        "media_clock_caught_up: %llu\n"
+                        "media_clock_skipped: %llu\n"
+                        "media_clock_max_lateness_us: %lld\n",
+                        static_cast<unsigned long long>(total.ticks),
+                        static_cast<unsigned long long>(total.caught_up),
+                        static_cast<unsigned long long>(total.skipped),
+                        static_cast<long long>(total.max_lateness_us));
+  for (int i = 0; i < kLatenessBuckets - 1; i++) {
+    len += sprintfn(buffer + len, sizeof(buffer) - len,
+                    "media_clock_lateness_le_%lldus: %llu\n",
+                    static_cast<long long>(kLatenessBucketUs[i]),
+                    static_cast<unsigned long long>(total.lateness[i]));
+  }
+  sprintfn(buffer + len, sizeof(buffer) - len,
+           "media_clock_lateness_gt_%lldus: %llu\n",
+           static_cast<long long>(kLatenessBucketUs[kLatenessBuckets - 2]),
+           static_cast<unsigned long long>(
+               total.lateness[kLatenessBuckets - 1]));
+  return buffer;
+}
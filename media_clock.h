@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_MEDIA_CLOCK_H_
+#define PEERCONNECTION_MEDIA_CLOCK_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtc_base/criticalsection.h"
+#include "rtc_base/platform_thread.h"
+
+// Advanced by the media clock every 10 ms, from one of its threads.
+class MediaClockClient {
+ public:
+  // Records and plays out one 10 ms frame, must not block.
+  virtual void OnMediaTick() = 0;
+
+ protected:
+  virtual ~MediaClockClient() {}
+};
+
+// A few realtime threads driving the 10 ms cadence of every audio device,
+// instead of a capture and a playout thread per device. Each thread ticks
+// its clients in a batch, so the thread count and the wakeups do not grow
+// with the calls.
+//
+// Ticks are due at absolute monotonic deadlines, a late tick does not push
+// the following ones back. A thread late by less than the catch-up budget
+// runs the missed ticks back to back, later than that the missed frames
+// are skipped and the cadence restarts.
+class MediaClock {
+ public:
+  // Upper bounds of the lateness histogram buckets, in microseconds, the
+  // last bucket counts anything later.
+  static const int kLatenessBuckets = 7;
+  static const int64_t kLatenessBucketUs[kLatenessBuckets - 1];
+
+  MediaClock();
+  ~MediaClock();
+
+  // |max_catchup_ms| is the lateness made up for by running missed ticks
+  // back to back, 0 always skips them.
+  bool Start(int threads, int max_catchup_ms);
+  void Stop();
+
+  // Clients are spread on the least loaded thread. Adding a client twice
+  // does nothing.
+  void AddClient(MediaClockClient* client);
+  // Returns once the client is out of its tick, it is not called anymore.
+  void RemoveClient(MediaClockClient* client);
+
+  size_t threads() const { return tickers_.size(); }
+  // Plain text tick and lateness counters, summed over the threads.
+  std::string GetStats() const;
+
+ protected:
+  // Written by the ticker thread, read by GetStats().
+  struct TickStats {
+    TickStats();
+
+    uint64_t ticks;
+    // Ticks run late by a whole interval or more, to catch up.
+    uint64_t caught_up;
+    // Ticks dropped because the thread was too late.
+    uint64_t skipped;
+    int64_t max_lateness_us;
+    uint64_t lateness[kLatenessBuckets];
+  };
+
+  struct Ticker {
+    Ticker();
+
+    MediaClock* clock;
+    std::unique_ptr<rtc::PlatformThread> thread;
+    // Held for a whole batch, so a removed client is never ticked again.
+    rtc::CriticalSection lock;
+    std::vector<MediaClockClient*> clients;
+    // Absolute monotonic deadline of the next tick.
+    int64_t next_tick_ns;
+    rtc::CriticalSection stats_lock;
+    TickStats stats;
+  };
+
+  static bool TickerThreadFunc(void* ticker);
+  bool Tick(Ticker* ticker);
+
+  std::vector<std::unique_ptr<Ticker> > tickers_;
+  int64_t max_catchup_ns_;
+  // Read by every ticker thread.
+  std::atomic<bool> running_;
+};
+
+#endif  // PEERCONNECTION_MEDIA_CLOCK_H_
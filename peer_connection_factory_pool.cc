@@ -0,0 +1,207 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/peer_connection_factory_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "api/audio_codecs/builtin_audio_decoder_factory.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/refcountedobject.h"
+#include "rtc_base/stringutils.h"
+
+using rtc::sprintfn;
+
+namespace {
+
+const char kAudioInputFile[] = "/audio/input_48K_16bits_pcm.raw";
+const char kAudioRecordingFile[] = "/audio/recording.raw";
+
+std::unique_ptr<rtc::Thread> StartThread(std::unique_ptr<rtc::Thread> thread,
+                                         const char* prefix, size_t index) {
+  char name[64];
+  sprintfn(name, sizeof(name), "%s_%i", prefix, static_cast<int>(index));
+  thread->SetName(name, nullptr);
+  thread->Start();
+  return thread;
+}
+
+}  // namespace
+
+PeerConnectionFactoryPool::PeerConnectionFactoryPool(
+    rtc::Thread* signaling_thread)
+  : signaling_thread_(signaling_thread),
+    placement_(ROUND_ROBIN),
+    next_shard_(0) {
+}
+
+PeerConnectionFactoryPool::~PeerConnectionFactoryPool() {
+  Terminate();
+}
+
+bool PeerConnectionFactoryPool::ParsePlacement(const std::string& name,
+                                               Placement* placement) {
+  if (name == "round_robin") {
+    *placement = ROUND_ROBIN;
+  } else if (name == "least_loaded") {
+    *placement = LEAST_LOADED;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool PeerConnectionFactoryPool::Init(int network_threads, int worker_threads,
+                                     int media_clock_threads,
+                                     int media_clock_catchup_ms,
+                                     bool record_playout,
+                                     Placement placement) {
+  RTC_DCHECK(shards_.empty());
+  if (network_threads < 1 || worker_threads < 1) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": invalid thread count network:"
+                      << network_threads << " worker:" << worker_threads;
+    return false;
+  }
+  placement_ = placement;
+  if (!media_clock_.Start(media_clock_threads, media_clock_catchup_ms))
+    return false;
+  audio_writers_.Start();
+
+  for (int i = 0; i < network_threads; i++) {
+    network_threads_.push_back(StartThread(
+        rtc::Thread::CreateWithSocketServer(), "rtc_gw_network", i));
+  }
+  for (int i = 0; i < worker_threads; i++) {
+    worker_threads_.push_back(StartThread(
+        rtc::Thread::Create(), "rtc_gw_worker", i));
+  }
+
+  size_t count = std::max(network_threads_.size(), worker_threads_.size());
+  for (size_t i = 0; i < count; i++) {
+    // Each factory owns an audio device, only the first one keeps the
+    // historical recording file name. Without a file the device still
+    // pulls the mix, it drives the decoding of the remote tracks.
+    std::string recording = record_playout ? kAudioRecordingFile : "";
+    if (record_playout && i > 0) {
+      char name[64];
+      sprintfn(name, sizeof(name), "/audio/recording_%i.raw",
+               static_cast<int>(i));
+      recording = name;
+    }
+    Shard shard;
+    shard.sessions = 0;
+    shard.audio_device = new rtc::RefCountedObject<rtcgw::FileAudioDevice>(
+        kAudioInputFile, recording.c_str(), &media_clock_, &audio_sources_,
+        &audio_writers_);
+    shard.factory = webrtc::CreatePeerConnectionFactory(
+        network_threads_[i % network_threads_.size()].get(),
+        worker_threads_[i % worker_threads_.size()].get(),
+        signaling_thread_,
+        shard.audio_device.get(),
+        webrtc::CreateBuiltinAudioEncoderFactory(),
+        webrtc::CreateBuiltinAudioDecoderFactory(),
+        nullptr,
+        nullptr);
+    if (!shard.factory.get()) {
+      RTC_LOG(LS_ERROR) << "Error Failed to initialize PeerConnectionFactory"
+                        << " shard:" << i;
+      Terminate();
+      return false;
+    }
+    shards_.push_back(std::move(shard));
+  }
+  RTC_LOG(INFO) << __FUNCTION__ << " shards:" << shards_.size()
+                << " network threads:" << network_threads_.size()
+                << " worker threads:" << worker_threads_.size()
+                << " media clock threads:" << media_clock_.threads();
+  return true;
+}
+
+void PeerConnectionFactoryPool::Terminate() {
+  // Factories go first, they still use the threads and the audio devices,
+  // the devices leave the media clock when released.
+  for (auto& shard : shards_)
+    shard.factory = nullptr;
+  shards_.clear();
+  media_clock_.Stop();
+  audio_writers_.Stop();
+  for (auto& thread : network_threads_)
+    thread->Stop();
+  for (auto& thread : worker_threads_)
+    thread->Stop();
+  network_threads_.clear();
+  worker_threads_.clear();
+  // Their pending messages went with the threads.
+  network_managers_.clear();
+}
+
+bool PeerConnectionFactoryPool::BindNetworks(const std::string& listen_ip) {
+  RTC_DCHECK(network_managers_.empty());
+  rtc::IPAddress ip;
+  if (!rtc::IPFromString(listen_ip, &ip) || rtc::IPIsAny(ip)) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": not a specific IP:" << listen_ip;
+    return false;
+  }
+  for (size_t i = 0; i < network_threads_.size(); i++)
+    network_managers_.emplace_back(new ListenNetworkManager(ip));
+  return true;
+}
+
+int PeerConnectionFactoryPool::Acquire() {
+  RTC_DCHECK(signaling_thread_->IsCurrent());
+  RTC_DCHECK(!shards_.empty());
+  size_t shard = 0;
+  if (placement_ == LEAST_LOADED) {
+    for (size_t i = 1; i < shards_.size(); i++) {
+      if (shards_[i].sessions < shards_[shard].sessions)
+        shard = i;
+    }
+  } else {
+    shard = next_shard_;
+    next_shard_ = (next_shard_ + 1) % shards_.size();
+  }
+  shards_[shard].sessions++;
+  return static_cast<int>(shard);
+}
+
+void PeerConnectionFactoryPool::Release(int shard) {
+  RTC_DCHECK(signaling_thread_->IsCurrent());
+  RTC_DCHECK(shard >= 0 && static_cast<size_t>(shard) < shards_.size());
+  RTC_DCHECK(shards_[shard].sessions > 0);
+  shards_[shard].sessions--;
+}
+
+webrtc::PeerConnectionFactoryInterface* PeerConnectionFactoryPool::factory(
+    int shard) const {
+  RTC_DCHECK(shard >= 0 && static_cast<size_t>(shard) < shards_.size());
+  return shards_[shard].factory.get();
+}
+
+rtc::NetworkManager* PeerConnectionFactoryPool::network_manager(
+    int shard) const {
+  RTC_DCHECK(shard >= 0 && static_cast<size_t>(shard) < shards_.size());
+  if (network_managers_.empty())
+    return NULL;
+  // Shard i runs on network thread i % network_threads, see Init().
+  return network_managers_[shard % network_managers_.size()].get();
+}
+
+std::string PeerConnectionFactoryPool::GetStats() const {
+  char buffer[128];
+  sprintfn(buffer, sizeof(buffer),
+           "audio_sources: %i\n"
+           "audio_source_bytes: %llu\n",
+           static_cast<int>(audio_sources_.sources()),
+           static_cast<unsigned long long>(audio_sources_.mapped_bytes()));
+  return media_clock_.GetStats() + buffer + audio_writers_.GetStats();
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_FACTORY_POOL_H_
+#define PEERCONNECTION_FACTORY_POOL_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/peerconnectioninterface.h"
+#include "examples/rtc_gw/audio_device_module.h"
+#include "examples/rtc_gw/audio_source_cache.h"
+#include "examples/rtc_gw/listen_network_manager.h"
+#include "examples/rtc_gw/media_clock.h"
+#include "rtc_base/thread.h"
+
+// A PeerConnectionFactory is bound to a single network and worker thread,
+// media work is spread across cores by creating one factory per shard and
+// placing each new session on one of them.
+class PeerConnectionFactoryPool {
+ public:
+  enum Placement {
+    ROUND_ROBIN,
+    LEAST_LOADED,
+  };
+
+  explicit PeerConnectionFactoryPool(rtc::Thread* signaling_thread);
+  ~PeerConnectionFactoryPool();
+
+  // Creates max(network_threads, worker_threads) shards, shard i runs on
+  // network thread i % network_threads and worker thread i % worker_threads.
+  // The audio devices of all the shards are paced by |media_clock_threads|,
+  // see MediaClock::Start() for |media_clock_catchup_ms|. Each device writes
+  // its playout mix to a file if |record_playout|.
+  bool Init(int network_threads, int worker_threads, int media_clock_threads,
+            int media_clock_catchup_ms, bool record_playout,
+            Placement placement);
+  void Terminate();
+  // Gathers on |listen_ip| only, for ICE-lite: each network thread gets a
+  // NetworkManager exposing that address alone. False if it is not a
+  // specific IP.
+  bool BindNetworks(const std::string& listen_ip);
+
+  // Picks the shard of a new session, Release() must be called when the
+  // session is closed.
+  int Acquire();
+  void Release(int shard);
+
+  webrtc::PeerConnectionFactoryInterface* factory(int shard) const;
+  // For the port allocator of the sessions of |shard|, NULL if the
+  // networks are not bound.
+  rtc::NetworkManager* network_manager(int shard) const;
+  // Writes the recordings, for the sessions too.
+  AudioWriterThread* audio_writers() { return &audio_writers_; }
+  // Plain text media clock, audio source and recording counters.
+  std::string GetStats() const;
+  size_t size() const { return shards_.size(); }
+
+  static bool ParsePlacement(const std::string& name, Placement* placement);
+
+ protected:
+  struct Shard {
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
+    rtc::scoped_refptr<rtcgw::FileAudioDevice> audio_device;
+    int sessions;
+  };
+
+  rtc::Thread* signaling_thread_;
+  MediaClock media_clock_;
+  // Outlive the audio devices using them.
+  AudioSourceCache audio_sources_;
+  AudioWriterThread audio_writers_;
+  std::vector<std::unique_ptr<rtc::Thread> > network_threads_;
+  std::vector<std::unique_ptr<rtc::Thread> > worker_threads_;
+  // One per network thread once bound, outlive the factories.
+  std::vector<std::unique_ptr<ListenNetworkManager> > network_managers_;
+  std::vector<Shard> shards_;
+  Placement placement_;
+  size_t next_shard_;
+};
+
+#endif  // PEERCONNECTION_FACTORY_POOL_H_
@@ -11,11 +11,20 @@
 
 #include "examples/rtc_gw/peer_connection_listener.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <utility>
+
 #include "examples/rtc_gw/defaults.h"
+#include "examples/rtc_gw/websocket_frame_parser.h"
 #include "rtc_base/checks.h"
+#include "rtc_base/json.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/nethelpers.h"
 #include "rtc_base/stringutils.h"
+#include "rtc_base/timeutils.h"
 
 #ifdef WIN32
 #include "rtc_base/win32socketserver.h"
@@ -29,6 +38,24 @@ namespace {
 const char kByeMessage[] = "BYE";
 // Delay between server connection retries, in milliseconds
 const int kReconnectDelay = 2000;
+// Interval of the accept rate computation, in milliseconds
+const int kAcceptStatsInterval = 10000;
+// Interval of the idle keep-alive connection check, in milliseconds
+const int kIdleSweepInterval = 1000;
+// A candidate poll is answered empty after this delay, in milliseconds
+const int kCandidatePollTimeout = 25000;
+
+// WebSocket message types and members.
+const char kTypeName[] = "type";
+const char kSessionIdName[] = "session_id";
+const char kSecurityName[] = "security";
+const char kRecordingName[] = "recording";
+const char kOfferType[] = "offer";
+const char kAnswerType[] = "answer";
+const char kCandidateType[] = "candidate";
+const char kByeType[] = "bye";
+const char kEndOfCandidatesType[] = "end-of-candidates";
+const char kErrorType[] = "error";
 
 rtc::AsyncSocket* CreateServerSocket(int family) {
   rtc::Thread* thread = rtc::Thread::Current();
@@ -36,16 +63,77 @@ rtc::AsyncSocket* CreateServerSocket(int family) {
   return thread->socketserver()->CreateAsyncSocket(family, SOCK_STREAM);
 }
 
+// System wide count of connections dropped because an accept queue was full.
+bool ReadListenOverflows(uint64_t* overflows, uint64_t* drops) {
+#if defined(WEBRTC_LINUX)
+  FILE* file = fopen("/proc/net/netstat", "r");
+  if (!file)
+    return false;
+  char names[4096];
+  char values[4096];
+  bool found = false;
+  while (fgets(names, sizeof(names), file) &&
+         fgets(values, sizeof(values), file)) {
+    if (strncmp(names, "TcpExt:", 7) != 0)
+      continue;
+    char* name_save = NULL;
+    char* value_save = NULL;
+    char* name = strtok_r(names, " \n", &name_save);
+    char* value = strtok_r(values, " \n", &value_save);
+    while (name && value) {
+      if (strcmp(name, "ListenOverflows") == 0) {
+        *overflows = strtoull(value, NULL, 10);
+        found = true;
+      } else if (strcmp(name, "ListenDrops") == 0) {
+        *drops = strtoull(value, NULL, 10);
+      }
+      name = strtok_r(NULL, " \n", &name_save);
+      value = strtok_r(NULL, " \n", &value_save);
+    }
+    break;
+  }
+  fclose(file);
+  return found;
+#else
+  return false;
+#endif
+}
+
 }  // namespace
 
+PeerConnectionListener::CandidateQueue::CandidateQueue()
+  : complete(false),
+    poll_connection_id(0),
+    poll_start_ms(0) {
+}
+
 PeerConnectionListener::PeerConnectionListener()
   : callback_(NULL),
     resolver_(NULL),
+    next_connection_id_(1),
+    next_session_id_(1),
+    listen_backlog_(0),
+    keepalive_timeout_ms_(0),
+    accepted_(0),
+    accept_wakeups_(0),
+    accept_backlog_full_(0),
+    accept_max_batch_(0),
+    accepted_at_last_update_(0),
+    last_accept_stats_ms_(0),
+    accept_rate_(0),
+    requests_(0),
+    keepalive_requests_(0),
+    idle_closed_(0),
+    websocket_upgrades_(0),
+    websocket_messages_(0),
+    candidates_received_(0),
+    candidates_sent_(0),
     state_(NOT_CONNECTED),
     my_id_(-1) {
 }
 
 PeerConnectionListener::~PeerConnectionListener() {
+  rtc::Thread::Current()->Clear(this);
 }
 
 void PeerConnectionListener::InitSocketSignals() {
@@ -84,24 +172,306 @@ void PeerConnectionListener::RegisterObserver(
 }
 
 bool PeerConnectionListener::SendToPeer(int peer_id, const std::string& message) {
-  if (peer_id == 7) {
-    char headers[1024];
-    sprintfn(headers, sizeof(headers),
-    "HTTP/1.1 200 OK\r\n"
-    "Server: RTC_GW/0.1\r\n"
-    "Cache-Control: no-cache\r\n"
-    "Content-Length: %i\r\n"
-    "Content-Type: text/plain\r\n"
-    "\r\n",
-       message.length());
-    std::string answer = headers;
-    // answer += message.substr(14, message.length() - 40);
-    answer += message; //.substr(14, message.length() - 40);
-    size_t sent = server_new_socket_->Send(answer.data(), answer.length());
-    RTC_LOG(INFO) << "sent:" << sent;
-    server_new_socket_->Close();
-  }
-  return 1;
+  auto it = session_connections_.find(peer_id);
+  if (it == session_connections_.end()) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": no connection for session:" << peer_id;
+    return false;
+  }
+  SessionRoute route = it->second;
+  auto connection = connections_.find(route.connection_id);
+  if (connection == connections_.end()) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": connection:" << route.connection_id
+                      << " of session:" << peer_id << " is gone";
+    session_connections_.erase(it);
+    return false;
+  }
+
+  if (connection->second->websocket()) {
+    if (route.reply == REPLY_ANSWER) {
+      it->second.answered = true;
+      return SendWebSocketMessage(connection->second.get(), kAnswerType,
+                                  peer_id, "sdp", message);
+    }
+    session_connections_.erase(it);
+    return SendWebSocketMessage(connection->second.get(), kByeType, peer_id,
+                                "reason", message);
+  }
+  session_connections_.erase(it);
+  if (route.reply == REPLY_ANSWER) {
+    // Candidates gathered from now on wait for a poll.
+    candidate_queues_[peer_id];
+  }
+
+  char session_header[64];
+  sprintfn(session_header, sizeof(session_header), "Session-Id: %i\r\n",
+           peer_id);
+  bool sent = SendResponse(connection->second.get(), 200, session_header,
+                           message);
+  RTC_LOG(INFO) << "sent:" << sent << " session:" << peer_id;
+  return sent;
+}
+
+bool PeerConnectionListener::SendErrorToPeer(int session_id, int status,
+                                             const std::string& reason) {
+  auto it = session_connections_.find(session_id);
+  if (it == session_connections_.end()) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": no connection for session:"
+                      << session_id;
+    return false;
+  }
+  SessionRoute route = it->second;
+  session_connections_.erase(it);
+  auto connection = connections_.find(route.connection_id);
+  if (connection == connections_.end())
+    return false;
+  RTC_LOG(LS_WARNING) << __FUNCTION__ << " session:" << session_id
+                      << " status:" << status << " reason:" << reason;
+  if (connection->second->websocket()) {
+    return SendWebSocketMessage(connection->second.get(), kErrorType,
+                                session_id, "reason", reason);
+  }
+  char session_header[64];
+  sprintfn(session_header, sizeof(session_header), "Session-Id: %i\r\n",
+           session_id);
+  return SendResponse(connection->second.get(), status, session_header,
+                      reason);
+}
+
+bool PeerConnectionListener::SendResponse(SignalingConnection* connection,
+                                          int status,
+                                          const std::string& extra_headers,
+                                          const std::string& body) {
+  const char* reason = "OK";
+  switch (status) {
+    case 101: reason = "Switching Protocols"; break;
+    case 200: reason = "OK"; break;
+    case 400: reason = "Bad Request"; break;
+    case 404: reason = "Not Found"; break;
+    case 409: reason = "Conflict"; break;
+    case 500: reason = "Internal Server Error"; break;
+    case 503: reason = "Service Unavailable"; break;
+    case 504: reason = "Gateway Timeout"; break;
+    default: reason = "Error"; break;
+  }
+  if (keepalive_timeout_ms_ <= 0)
+    connection->DisableKeepAlive();
+  char headers[1024];
+  sprintfn(headers, sizeof(headers),
+  "HTTP/1.1 %i %s\r\n"
+  "Server: RTC_GW/0.1\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: %s\r\n"
+  "%s"
+  "Content-Length: %i\r\n"
+  "Content-Type: text/plain\r\n"
+  "\r\n",
+     status, reason, connection->keep_alive() ? "keep-alive" : "close",
+     extra_headers.c_str(), static_cast<int>(body.length()));
+  std::string response = headers;
+  response += body;
+  return connection->SendResponse(response);
+}
+
+bool PeerConnectionListener::AcceptWebSocket(
+    SignalingConnection* connection, const HttpRequestParser& request) {
+  std::string upgrade;
+  std::string key;
+  std::string version;
+  request.GetHeader("Upgrade", &upgrade);
+  request.GetHeader("Sec-WebSocket-Version", &version);
+  if (strcasecmp(upgrade.c_str(), "websocket") != 0 || version != "13" ||
+      !request.GetHeader("Sec-WebSocket-Key", &key) || key.empty()) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << " invalid upgrade request";
+    return SendResponse(connection, 400, "", "websocket upgrade expected");
+  }
+  char response[256];
+  sprintfn(response, sizeof(response),
+  "HTTP/1.1 101 Switching Protocols\r\n"
+  "Server: RTC_GW/0.1\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: Upgrade\r\n"
+  "Sec-WebSocket-Accept: %s\r\n"
+  "\r\n",
+     WebSocketFrameParser::ComputeAcceptKey(key).c_str());
+  websocket_upgrades_++;
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection->id();
+  return connection->AcceptWebSocket(response);
+}
+
+bool PeerConnectionListener::SendWebSocketMessage(
+    SignalingConnection* connection, const char* type, int session_id,
+    const char* name, const std::string& value) {
+  Json::Value jmessage;
+  jmessage[kTypeName] = std::string(type);
+  if (session_id > 0)
+    jmessage[kSessionIdName] = session_id;
+  if (name)
+    jmessage[name] = value;
+  Json::FastWriter writer;
+  return connection->SendText(writer.write(jmessage));
+}
+
+void PeerConnectionListener::OnConnectionMessage(
+    SignalingConnection* connection, const std::string& message) {
+  websocket_messages_++;
+  Json::Reader reader;
+  Json::Value jmessage;
+  if (!reader.parse(message, jmessage)) {
+    RTC_LOG(LS_WARNING) << __FUNCTION__ << " invalid message:" << message;
+    SendWebSocketMessage(connection, kErrorType, 0, "reason",
+                         "invalid message");
+    return;
+  }
+  std::string type;
+  int session_id = 0;
+  rtc::GetStringFromJsonObject(jmessage, kTypeName, &type);
+  rtc::GetIntFromJsonObject(jmessage, kSessionIdName, &session_id);
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection->id()
+                   << " type:" << type << " session:" << session_id;
+
+  if (type == kOfferType) {
+    std::string security;
+    std::string recording;
+    rtc::GetStringFromJsonObject(jmessage, kSecurityName, &security);
+    rtc::GetStringFromJsonObject(jmessage, kRecordingName, &recording);
+    session_id = next_session_id_++;
+    SessionRoute route = {connection->id(), REPLY_ANSWER, false};
+    session_connections_[session_id] = route;
+    if (!callback_->OnOfferFromPeer(session_id, message, security,
+                                    recording)) {
+      session_connections_.erase(session_id);
+      SendWebSocketMessage(connection, kErrorType, 0, "reason",
+                           "invalid security or recording");
+    }
+    return;
+  }
+
+  // Other messages refer to a session opened on this connection.
+  auto it = session_connections_.find(session_id);
+  if (it == session_connections_.end() ||
+      it->second.connection_id != connection->id()) {
+    SendWebSocketMessage(connection, kErrorType, session_id, "reason",
+                         "unknown session");
+    return;
+  }
+  if (type == kCandidateType) {
+    // The session only expects the candidate members.
+    jmessage.removeMember(kTypeName);
+    jmessage.removeMember(kSessionIdName);
+    Json::FastWriter writer;
+    candidates_received_++;
+    if (!callback_->OnCandidateFromPeer(session_id, writer.write(jmessage))) {
+      SendWebSocketMessage(connection, kErrorType, session_id, "reason",
+                           "unknown session");
+    }
+  } else if (type == kByeType) {
+    it->second.reply = REPLY_BYE;
+    callback_->OnPeerDisconnected(session_id);
+  } else {
+    SendWebSocketMessage(connection, kErrorType, session_id, "reason",
+                         "unknown message type");
+  }
+}
+
+void PeerConnectionListener::SendCandidate(int session_id,
+                                           const std::string& candidate) {
+  auto route = session_connections_.find(session_id);
+  if (route != session_connections_.end()) {
+    auto connection = connections_.find(route->second.connection_id);
+    if (connection != connections_.end() &&
+        connection->second->websocket()) {
+      SignalingConnection* websocket = connection->second.get();
+      if (candidate.empty()) {
+        SendWebSocketMessage(websocket, kEndOfCandidatesType, session_id,
+                             NULL, "");
+        return;
+      }
+      Json::Reader reader;
+      Json::Value jmessage;
+      if (!reader.parse(candidate, jmessage))
+        return;
+      jmessage[kTypeName] = std::string(kCandidateType);
+      jmessage[kSessionIdName] = session_id;
+      Json::FastWriter writer;
+      websocket->SendText(writer.write(jmessage));
+      candidates_sent_++;
+      return;
+    }
+  }
+
+  auto queue = candidate_queues_.find(session_id);
+  if (queue == candidate_queues_.end()) {
+    RTC_LOG(LS_WARNING) << __FUNCTION__ << " no client for session:"
+                        << session_id;
+    return;
+  }
+  if (candidate.empty())
+    queue->second.complete = true;
+  else
+    queue->second.candidates.push_back(candidate);
+  FlushCandidates(session_id);
+}
+
+void PeerConnectionListener::FlushCandidates(int session_id, bool empty) {
+  auto queue = candidate_queues_.find(session_id);
+  if (queue == candidate_queues_.end() ||
+      queue->second.poll_connection_id == 0)
+    return;
+  CandidateQueue& candidates = queue->second;
+  auto connection = connections_.find(candidates.poll_connection_id);
+  candidates.poll_connection_id = 0;
+  if (connection == connections_.end())
+    return;
+  // The candidates are JSON objects already.
+  std::string body = "{\"candidates\":[";
+  if (!empty) {
+    for (size_t i = 0; i < candidates.candidates.size(); i++) {
+      if (i > 0)
+        body += ",";
+      body += candidates.candidates[i];
+    }
+  }
+  body += "],\"complete\":";
+  body += candidates.complete && !empty ? "true}" : "false}";
+  if (!empty) {
+    candidates_sent_ += candidates.candidates.size();
+    candidates.candidates.clear();
+  }
+
+  char session_header[64];
+  sprintfn(session_header, sizeof(session_header), "Session-Id: %i\r\n",
+           session_id);
+  SendResponse(connection->second.get(), 200, session_header, body);
+}
+
+void PeerConnectionListener::ExpireCandidatePolls() {
+  int64_t now = rtc::TimeMillis();
+  for (auto& it : candidate_queues_) {
+    if (it.second.poll_connection_id != 0 &&
+        now - it.second.poll_start_ms > kCandidatePollTimeout) {
+      FlushCandidates(it.first);
+    }
+  }
+}
+
+void PeerConnectionListener::OnSessionClosed(int session_id) {
+  auto queue = candidate_queues_.find(session_id);
+  if (queue != candidate_queues_.end()) {
+    queue->second.complete = true;
+    FlushCandidates(session_id);
+    candidate_queues_.erase(queue);
+  }
+  // A session closed without a BYE from its WebSocket client.
+  auto route = session_connections_.find(session_id);
+  if (route != session_connections_.end()) {
+    auto connection = connections_.find(route->second.connection_id);
+    if (connection != connections_.end() &&
+        connection->second->websocket()) {
+      SendWebSocketMessage(connection->second.get(), kByeType, session_id,
+                           "reason", "session closed");
+    }
+    session_connections_.erase(route);
+  }
 }
 
 bool PeerConnectionListener::SendHangUp(int peer_id) {
@@ -166,19 +536,12 @@ bool PeerConnectionListener::ConnectControlSocket() {
 // Server BEGIN
 void PeerConnectionListener::InitServerSocketSignals() {
   RTC_DCHECK(server_socket_.get() != NULL);
-  server_socket_->SignalConnectEvent.connect(this, &PeerConnectionListener::OnServerConnect);
   server_socket_->SignalReadEvent.connect(this, &PeerConnectionListener::OnServerRead);
   server_socket_->SignalCloseEvent.connect(this, &PeerConnectionListener::OnServerClose);
 }
 
-void PeerConnectionListener::InitServerNewSocketSignals() {
-  //RTC_DCHECK(server_new_socket_->get() != NULL);
-  server_new_socket_->SignalConnectEvent.connect(this, &PeerConnectionListener::OnServerConnect);
-  server_new_socket_->SignalReadEvent.connect(this, &PeerConnectionListener::OnServerRead);
-  server_new_socket_->SignalCloseEvent.connect(this, &PeerConnectionListener::OnServerClose);
-}
-
-void PeerConnectionListener::Listen(const std::string& server, int port) {
+void PeerConnectionListener::Listen(const std::string& server, int port,
+                                    int backlog) {
   RTC_DCHECK(!server.empty());
   listen_address_.SetIP(server);
   listen_address_.SetPort(port);
@@ -190,51 +553,175 @@ void PeerConnectionListener::Listen(const std::string& server, int port) {
   if (err == SOCKET_ERROR) {
      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": error socket binding";
   }
-  err = server_socket_->Listen(10);
+  listen_backlog_ = backlog;
+  err = server_socket_->Listen(listen_backlog_);
   if (err == SOCKET_ERROR) {
      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": error socket listen";
   }
+  last_accept_stats_ms_ = rtc::TimeMillis();
+  rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kAcceptStatsInterval,
+                                      this, MSG_ACCEPT_STATS);
+  rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kIdleSweepInterval,
+                                      this, MSG_IDLE_SWEEP);
   return;
 }
 
+void PeerConnectionListener::set_keepalive_timeout_ms(int timeout_ms) {
+  keepalive_timeout_ms_ = timeout_ms;
+}
+
+void PeerConnectionListener::CloseIdleConnections() {
+  int64_t now = rtc::TimeMillis();
+  std::vector<SignalingConnection*> idle;
+  for (auto& it : connections_) {
+    SignalingConnection* connection = it.second.get();
+    // WebSockets are long lived, they end when either side closes.
+    if (!connection->busy() && !connection->websocket() &&
+        now - connection->last_activity_ms() > keepalive_timeout_ms_) {
+      idle.push_back(connection);
+    }
+  }
+  // Closing removes the connection from |connections_|.
+  for (SignalingConnection* connection : idle) {
+    RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection->id();
+    connection->Close();
+  }
+  idle_closed_ += idle.size();
+}
+
 void PeerConnectionListener::OnServerClose(rtc::AsyncSocket* socket, int err) {
    RTC_LOG(LS_INFO) << __FUNCTION__ << " error:"<< err;
 }
-void PeerConnectionListener::OnServerConnect(rtc::AsyncSocket* socket) {
-   RTC_LOG(LS_INFO) << __FUNCTION__;
-}
 
-// (0)CLOSED (1)CONNECTING (2)CONNECTED
+// Drains every pending connection, one read event can stand for many.
 void PeerConnectionListener::OnServerRead(rtc::AsyncSocket* socket) {
-   RTC_LOG(LS_INFO) << __FUNCTION__ <<": socket["<<socket<<"] state:"<< socket->GetState();
-   if (socket->GetState() == 1) {
-      rtc::SocketAddress address;
-      server_new_socket_ = socket->Accept(&address);
-      InitServerNewSocketSignals();
-      if (!server_new_socket_) {
-         RTC_LOG(LS_ERROR) << "TCP accept failed with error "
-                       << server_new_socket_->GetError();
-         return;
-      }
+   RTC_DCHECK(socket == server_socket_.get());
+   int batch = 0;
+   while (true) {
+     rtc::SocketAddress address;
+     rtc::AsyncSocket* new_socket = socket->Accept(&address);
+     if (!new_socket) {
+        int err = socket->GetError();
+        if (err != EWOULDBLOCK && err != EAGAIN) {
+           RTC_LOG(LS_ERROR) << "TCP accept failed with error " << err;
+        }
+        break;
+     }
+     int connection_id = next_connection_id_++;
+     RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection_id
+                      << " from:" << address.ToString();
+     connections_[connection_id].reset(
+         new SignalingConnection(connection_id, new_socket, this));
+     batch++;
    }
-
-   size_t content_length = 0;
-   if (ReadIntoBuffer(server_new_socket_, &request_data_, &content_length)) {
-     RTC_LOG(LS_INFO) << __FUNCTION__ <<" received:"<< content_length <<" GetRequest...";
-     GetRequest(request_data_);
-     request_data_ = "";
-     RTC_LOG(LS_INFO) << __FUNCTION__ <<" received:"<< content_length;
-   } else {
-       size_t found = request_data_.find("/BYE");
-       if (found != std::string::npos) {
-          RTC_LOG(LS_INFO) <<__FUNCTION__ <<" do[BYE]";
-          callback_->OnPeerDisconnected(7);
-          request_data_ = "";
-          return;
-       }
+   accept_wakeups_++;
+   accepted_ += batch;
+   if (batch > accept_max_batch_)
+     accept_max_batch_ = batch;
+   if (listen_backlog_ > 0 && batch >= listen_backlog_) {
+     accept_backlog_full_++;
+     RTC_LOG(LS_WARNING) << __FUNCTION__ << " accept queue was full, "
+                         << batch << " connections pending";
    }
+}
+
+void PeerConnectionListener::UpdateAcceptStats() {
+  int64_t now = rtc::TimeMillis();
+  int64_t elapsed = now - last_accept_stats_ms_;
+  if (elapsed > 0) {
+    accept_rate_ = (accepted_ - accepted_at_last_update_) * 1000.0 / elapsed;
+  }
+  if (accepted_ != accepted_at_last_update_) {
+    RTC_LOG(LS_INFO) << __FUNCTION__ << " accepted:" << accepted_
+                     << " rate:" << accept_rate_ << "/s"
+                     << " backlog full:" << accept_backlog_full_;
+  }
+  accepted_at_last_update_ = accepted_;
+  last_accept_stats_ms_ = now;
+}
 
-   RTC_LOG(LS_INFO) << __FUNCTION__ <<"reading done, received:"<< content_length;
+std::string PeerConnectionListener::GetStats() const {
+  char buffer[1024];
+  uint64_t overflows = 0;
+  uint64_t drops = 0;
+  bool system = ReadListenOverflows(&overflows, &drops);
+  sprintfn(buffer, sizeof(buffer),
+           "listen_backlog: %i\n"
+           "connections: %i\n"
+           "accepted: %llu\n"
+           "accept_rate: %.1f\n"
+           "accept_wakeups: %llu\n"
+           "accept_max_batch: %i\n"
+           "accept_backlog_full: %llu\n"
+           "requests: %llu\n"
+           "keepalive_requests: %llu\n"
+           "idle_closed: %llu\n"
+           "websocket_upgrades: %llu\n"
+           "websocket_messages: %llu\n"
+           "candidates_received: %llu\n"
+           "candidates_sent: %llu\n"
+           "tcp_listen_overflows: %lld\n"
+           "tcp_listen_drops: %lld\n",
+           listen_backlog_,
+           static_cast<int>(connections_.size()),
+           static_cast<unsigned long long>(accepted_),
+           accept_rate_,
+           static_cast<unsigned long long>(accept_wakeups_),
+           accept_max_batch_,
+           static_cast<unsigned long long>(accept_backlog_full_),
+           static_cast<unsigned long long>(requests_),
+           static_cast<unsigned long long>(keepalive_requests_),
+           static_cast<unsigned long long>(idle_closed_),
+           static_cast<unsigned long long>(websocket_upgrades_),
+           static_cast<unsigned long long>(websocket_messages_),
+           static_cast<unsigned long long>(candidates_received_),
+           static_cast<unsigned long long>(candidates_sent_),
+           system ? static_cast<long long>(overflows) : -1LL,
+           system ? static_cast<long long>(drops) : -1LL);
+  return buffer;
+}
+
+void PeerConnectionListener::OnConnectionRequest(
+    SignalingConnection* connection, const HttpRequestParser& request) {
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection->id()
+                   << " received:" << request.content_length();
+  requests_++;
+  if (connection->requests() > 1)
+    keepalive_requests_++;
+  HandleRequest(connection, request);
+}
+
+void PeerConnectionListener::OnConnectionClosed(
+    SignalingConnection* connection) {
+  auto it = connections_.find(connection->id());
+  if (it == connections_.end())
+    return;
+  if (closed_connections_.empty()) {
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this,
+                                 MSG_DELETE_CLOSED_CONNECTIONS);
+  }
+  closed_connections_.push_back(std::move(it->second));
+  connections_.erase(it);
+  if (!connection->websocket())
+    return;
+  // Nobody is left to send the BYE of the sessions opened on the WebSocket,
+  // they are hung up here. Those already hanging up are only forgotten.
+  std::vector<int> sessions;
+  for (auto route = session_connections_.begin();
+       route != session_connections_.end();) {
+    if (route->second.connection_id != connection->id()) {
+      ++route;
+      continue;
+    }
+    if (route->second.reply == REPLY_ANSWER)
+      sessions.push_back(route->first);
+    route = session_connections_.erase(route);
+  }
+  for (int session_id : sessions) {
+    RTC_LOG(LS_INFO) << __FUNCTION__ << " connection:" << connection->id()
+                     << " hanging up session:" << session_id;
+    callback_->OnPeerDisconnected(session_id);
+  }
 }
 
 void PeerConnectionListener::OnConnect(rtc::AsyncSocket* socket) {
@@ -455,29 +942,114 @@ int PeerConnectionListener::GetResponseStatus(const std::string& response) {
   return status;
 }
 
-bool PeerConnectionListener::GetRequest(const std::string& request) {
-  RTC_LOG(LS_INFO) <<__FUNCTION__ <<" >> "<< request;
-  size_t pos = request.find('/');
-  if (pos != std::string::npos) {
-    if (request.substr(pos+1, 5).compare("OFFER") == 0) {
-       RTC_LOG(LS_INFO) <<__FUNCTION__ <<" do["<<request.substr(pos+1, 5) <<"]";
+bool PeerConnectionListener::HandleRequest(SignalingConnection* connection,
+                                           const HttpRequestParser& request) {
+  RTC_LOG(LS_INFO) <<__FUNCTION__ <<" >> "<< request.method() << " "
+                   << request.path();
+  if (request.PathIs("/OFFER")) {
+    if (request.body().empty()) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " OFFER without body";
+      return SendResponse(connection, 400, "", "missing offer");
+    }
+    // Media security from "security=" or a "Media-Security" header.
+    std::string security;
+    if (!request.GetQueryParameter(kSecurityName, &security))
+      request.GetHeader("Media-Security", &security);
+    // Recording file name from "recording=".
+    std::string recording;
+    request.GetQueryParameter(kRecordingName, &recording);
+    int session_id = next_session_id_++;
+    SessionRoute route = {connection->id(), REPLY_ANSWER, false};
+    session_connections_[session_id] = route;
+    if (!callback_->OnOfferFromPeer(session_id, request.body(), security,
+                                    recording)) {
+      session_connections_.erase(session_id);
+      return SendResponse(connection, 400, "",
+                          "invalid security or recording");
+    }
+    return true;
+  }
 
-    } else {
-       return false;
+  if (request.PathIs("/BYE")) {
+    int session_id = 0;
+    if (!GetSessionId(request, &session_id)) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " BYE without session id";
+      return SendResponse(connection, 400, "", "missing session id");
     }
-  } else {
-    return false;
+    RTC_LOG(LS_INFO) <<__FUNCTION__ <<" do[BYE] session:" << session_id;
+    // An offer still waiting for its answer is failed first, its connection
+    // would otherwise wait forever.
+    auto pending = session_connections_.find(session_id);
+    if (pending != session_connections_.end() &&
+        pending->second.reply == REPLY_ANSWER && !pending->second.answered)
+      SendErrorToPeer(session_id, 409, "closed by BYE");
+    // The BYE is answered on its own connection.
+    SessionRoute route = {connection->id(), REPLY_BYE, false};
+    session_connections_[session_id] = route;
+    callback_->OnPeerDisconnected(session_id);
+    return true;
+  }
+
+  if (request.PathIs("/CANDIDATE")) {
+    return HandleCandidateRequest(connection, request);
+  }
+
+  if (request.PathIs("/WS")) {
+    return AcceptWebSocket(connection, request);
+  }
+
+  if (request.PathIs("/STATS")) {
+    return SendResponse(connection, 200, "",
+                        GetStats() + callback_->GetSessionStats());
+  }
+
+  RTC_LOG(LS_WARNING) << __FUNCTION__ << " unknown request:" << request.path();
+  return SendResponse(connection, 404, "", "unknown request");
+}
+
+// POST adds a remote candidate, GET waits for local ones.
+bool PeerConnectionListener::HandleCandidateRequest(
+    SignalingConnection* connection, const HttpRequestParser& request) {
+  int session_id = 0;
+  if (!GetSessionId(request, &session_id)) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << " CANDIDATE without session id";
+    return SendResponse(connection, 400, "", "missing session id");
+  }
+
+  if (request.method() == "POST") {
+    if (request.body().empty())
+      return SendResponse(connection, 400, "", "missing candidate");
+    candidates_received_++;
+    if (!callback_->OnCandidateFromPeer(session_id, request.body()))
+      return SendResponse(connection, 404, "", "unknown session");
+    return SendResponse(connection, 200, "", "ok");
   }
-  size_t eoh = request.find("\r\n\r\n");
-  RTC_DCHECK(eoh != std::string::npos);
-  if (eoh == std::string::npos)
-    return false;
 
-  pos = eoh + 4;
-  OnMessageFromPeer(static_cast<int>(7), request.substr(pos));
+  auto queue = candidate_queues_.find(session_id);
+  if (queue == candidate_queues_.end())
+    return SendResponse(connection, 404, "", "unknown session");
+  // A newer poll replaces the waiting one, which is answered empty, the
+  // queued candidates go to the newest poll.
+  FlushCandidates(session_id, true);
+  queue->second.poll_connection_id = connection->id();
+  queue->second.poll_start_ms = rtc::TimeMillis();
+  if (!queue->second.candidates.empty() || queue->second.complete)
+    FlushCandidates(session_id);
   return true;
 }
 
+bool PeerConnectionListener::GetSessionId(const HttpRequestParser& request,
+                                          int* session_id) {
+  RTC_DCHECK(session_id != NULL);
+  std::string value;
+  if (!request.GetQueryParameter("session_id", &value) &&
+      !request.GetHeader("Session-Id", &value)) {
+    return false;
+  }
+  *session_id = atoi(value.c_str());
+  return *session_id > 0;
+}
+
 bool PeerConnectionListener::ParseServerResponse(const std::string& response,
                                                size_t content_length,
                                                size_t* peer_id,
@@ -526,7 +1098,7 @@ void PeerConnectionListener::OnClose(rtc::AsyncSocket* socket, int err) {
     if (socket == control_socket_.get()) {
       RTC_LOG(WARNING) << "Connection refused; retrying in 2 seconds";
       rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kReconnectDelay, this,
-                                          0);
+                                          MSG_RECONNECT);
     } else {
       Close();
       callback_->OnDisconnected();
@@ -535,6 +1107,24 @@ void PeerConnectionListener::OnClose(rtc::AsyncSocket* socket, int err) {
 }
 
 void PeerConnectionListener::OnMessage(rtc::Message* msg) {
-  // ignore msg; there is currently only one supported message ("retry")
-  // // // // // // // // // DoConnect();
+  switch (msg->message_id) {
+    case MSG_DELETE_CLOSED_CONNECTIONS:
+      closed_connections_.clear();
+      break;
+    case MSG_IDLE_SWEEP:
+      if (keepalive_timeout_ms_ > 0)
+        CloseIdleConnections();
+      ExpireCandidatePolls();
+      rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kIdleSweepInterval,
+                                          this, MSG_IDLE_SWEEP);
+      break;
+    case MSG_ACCEPT_STATS:
+      UpdateAcceptStats();
+      rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kAcceptStatsInterval,
+                                          this, MSG_ACCEPT_STATS);
+      break;
+    default:
+      // MSG_RECONNECT, retrying is not supported in listen mode.
+      break;
+  }
 }
@@ -15,7 +15,10 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "examples/rtc_gw/http_request_parser.h"
+#include "examples/rtc_gw/signaling_connection.h"
 #include "rtc_base/nethelpers.h"
 #include "rtc_base/physicalsocketserver.h"
 #include "rtc_base/signalthread.h"
@@ -29,16 +32,35 @@ struct PeerConnectionListenerObserver {
   virtual void OnPeerConnected(int id, const std::string& name) = 0;
   virtual void OnPeerDisconnected(int peer_id) = 0;
   virtual void OnMessageFromPeer(int peer_id, const std::string& message) = 0;
+  // Offer of a new session, |media_security| is the mode asked by the
+  // client and |recording| the name of its recording, empty for the
+  // defaults. False if the request is not acceptable.
+  virtual bool OnOfferFromPeer(int session_id, const std::string& offer,
+                               const std::string& media_security,
+                               const std::string& recording) = 0;
+  // Remote candidate for an existing session, false if it is unknown.
+  virtual bool OnCandidateFromPeer(int session_id,
+                                   const std::string& candidate) = 0;
   virtual void OnMessageSent(int err) = 0;
   virtual void OnServerConnectionFailure() = 0;
+  // Plain text counters appended to the listener ones on /STATS.
+  virtual std::string GetSessionStats() const = 0;
 
  protected:
   virtual ~PeerConnectionListenerObserver() {}
 };
 
 class PeerConnectionListener : public sigslot::has_slots<>,
-                             public rtc::MessageHandler {
+                             public rtc::MessageHandler,
+                             public SignalingConnectionObserver {
  public:
+  enum MessageID {
+    MSG_RECONNECT = 0,
+    MSG_DELETE_CLOSED_CONNECTIONS,
+    MSG_ACCEPT_STATS,
+    MSG_IDLE_SWEEP,
+  };
+
   enum State {
     NOT_CONNECTED,
     RESOLVING,
@@ -58,14 +80,28 @@ class PeerConnectionListener : public sigslot::has_slots<>,
   void RegisterObserver(PeerConnectionListenerObserver* callback);
 
   // Acting as a server
-  void Listen(const std::string& server, int port);
+  void Listen(const std::string& server, int port, int backlog);
+  // Idle keep-alive connections are closed after |timeout_ms|, 0 closes
+  // every connection after its response. Must be set before Listen().
+  void set_keepalive_timeout_ms(int timeout_ms);
   std::string listen_ip;
 
+  // Plain text counters served on /STATS.
+  std::string GetStats() const;
+
   // Connectiong to a peer connection server
   void Connect(const std::string& server, int port,
                const std::string& client_name);
 
   bool SendToPeer(int peer_id, const std::string& message);
+  // Fails the pending offer of a session with an HTTP |status|, or an
+  // error message on a WebSocket, so the client can retry elsewhere.
+  bool SendErrorToPeer(int session_id, int status, const std::string& reason);
+  // Trickles a local candidate in JSON form, empty at the end of gathering.
+  // It is pushed on a WebSocket or held for the next "GET /CANDIDATE".
+  void SendCandidate(int session_id, const std::string& candidate);
+  // Forgets the session once its last message was sent.
+  void OnSessionClosed(int session_id);
   bool SendHangUp(int peer_id);
   bool IsSendingMessage();
 
@@ -78,12 +114,9 @@ class PeerConnectionListener : public sigslot::has_slots<>,
   void Close();
   void InitSocketSignals();
   void InitServerSocketSignals();
-  void InitServerNewSocketSignals();
   bool ConnectControlSocket();
   void OnConnect(rtc::AsyncSocket* socket);
   void OnServerRead(rtc::AsyncSocket* socket);
-  void OnServerWrite(rtc::AsyncSocket* socket);
-  void OnServerConnect(rtc::AsyncSocket* socket);
   void OnServerClose(rtc::AsyncSocket* socket, int err);
   void OnHangingGetConnect(rtc::AsyncSocket* socket);
   void OnMessageFromPeer(int peer_id, const std::string& message);
@@ -108,7 +141,38 @@ class PeerConnectionListener : public sigslot::has_slots<>,
                   bool* connected);
 
   int GetResponseStatus(const std::string& response);
-  bool GetRequest(const std::string& request);
+  // SignalingConnectionObserver implementation.
+  void OnConnectionRequest(SignalingConnection* connection,
+                           const HttpRequestParser& request) override;
+  void OnConnectionMessage(SignalingConnection* connection,
+                           const std::string& message) override;
+  void OnConnectionClosed(SignalingConnection* connection) override;
+
+  // Dispatches a complete request received on |connection|.
+  bool HandleRequest(SignalingConnection* connection,
+                     const HttpRequestParser& request);
+  // Reads the session id from a "session_id=" query parameter or a
+  // "Session-Id" header.
+  bool GetSessionId(const HttpRequestParser& request, int* session_id);
+  bool SendResponse(SignalingConnection* connection, int status,
+                    const std::string& extra_headers,
+                    const std::string& body);
+  // Answers a "GET /WS" upgrade request.
+  bool AcceptWebSocket(SignalingConnection* connection,
+                       const HttpRequestParser& request);
+  // Sends {"type":type,"session_id":session_id,name:value}, |name| may be
+  // NULL.
+  bool SendWebSocketMessage(SignalingConnection* connection, const char* type,
+                            int session_id, const char* name,
+                            const std::string& value);
+  bool HandleCandidateRequest(SignalingConnection* connection,
+                              const HttpRequestParser& request);
+  // Answers the waiting candidate poll of a session, if any. With |empty|
+  // the queued candidates are kept for the next poll.
+  void FlushCandidates(int session_id, bool empty = false);
+  void ExpireCandidatePolls();
+  void UpdateAcceptStats();
+  void CloseIdleConnections();
 
 
   bool ParseServerResponse(const std::string& response, size_t content_length,
@@ -124,11 +188,62 @@ class PeerConnectionListener : public sigslot::has_slots<>,
   rtc::AsyncResolver* resolver_;
   std::unique_ptr<rtc::AsyncSocket> server_socket_;
   std::unique_ptr<rtc::AsyncSocket> control_socket_;
-  rtc::AsyncSocket *server_new_socket_;
+  // Accepted signaling connections keyed by connection id.
+  std::map<int, std::unique_ptr<SignalingConnection> > connections_;
+  // Closed connections, deleted from a posted message once their
+  // callbacks have returned.
+  std::vector<std::unique_ptr<SignalingConnection> > closed_connections_;
+  // What the next message sent to a session answers.
+  enum ReplyType {
+    REPLY_ANSWER,
+    REPLY_BYE,
+  };
+  struct SessionRoute {
+    int connection_id;
+    ReplyType reply;
+    // The answer went out, a WebSocket keeps the route afterwards.
+    bool answered;
+  };
+  // Connection waiting for the response of each session, keyed by session
+  // id. Ids are never reused so a stale entry cannot hit a new client. A
+  // WebSocket keeps its sessions until their BYE is answered or it closes.
+  std::map<int, SessionRoute> session_connections_;
+  // Local candidates of a session answered over HTTP, held until a
+  // "GET /CANDIDATE" long poll picks them up.
+  struct CandidateQueue {
+    CandidateQueue();
+    std::vector<std::string> candidates;
+    bool complete;
+    // Connection of the waiting poll, 0 if none.
+    int poll_connection_id;
+    int64_t poll_start_ms;
+  };
+  std::map<int, CandidateQueue> candidate_queues_;
+  int next_connection_id_;
+  int next_session_id_;
+  int listen_backlog_;
+  int keepalive_timeout_ms_;
+
+  // Accept counters, the rate is refreshed every kAcceptStatsInterval.
+  uint64_t accepted_;
+  uint64_t accept_wakeups_;
+  // Wakeups that drained a full backlog, new SYNs were likely dropped.
+  uint64_t accept_backlog_full_;
+  int accept_max_batch_;
+  uint64_t accepted_at_last_update_;
+  int64_t last_accept_stats_ms_;
+  double accept_rate_;
+  uint64_t requests_;
+  // Requests that reused a keep-alive connection.
+  uint64_t keepalive_requests_;
+  uint64_t idle_closed_;
+  uint64_t websocket_upgrades_;
+  uint64_t websocket_messages_;
+  uint64_t candidates_received_;
+  uint64_t candidates_sent_;
   std::unique_ptr<rtc::AsyncSocket> hanging_get_;
   std::string onconnect_data_;
   std::string control_data_;
-  std::string request_data_;
   std::string notification_data_;
   std::string client_name_;
   Peers peers_;
@@ -3,8 +3,9 @@
 echo 10 > /proc/sys/net/ipv4/tcp_fin_timeout
 echo 1  > /proc/sys/net/ipv4/tcp_tw_recycle
 echo 1  > /proc/sys/net/ipv4/tcp_tw_reuse
+echo 1024 > /proc/sys/net/core/somaxconn
 cd ../..
 IP=`ip addr | grep 'state UP' -A2 | tail -n1 | awk '{print $2}' | cut -f1  -d'/'`
-CMD="./out/Default/rtc_gw --port 9999 --listen $IP"
+CMD="./out/Default/rtc_gw --port 9999 --listen $IP --listen_backlog 1024 --network_threads `nproc` --worker_threads `nproc`"
 echo $CMD
 exec $CMD
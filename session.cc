@@ -0,0 +1,731 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "examples/rtc_gw/session.h"
+
+#include <memory>
+#include <utility>
+
+#include "api/test/fakeconstraints.h"
+#include "examples/rtc_gw/defaults.h"
+#include "p2p/base/portallocator.h"
+#include "p2p/client/basicportallocator.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/json.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/timeutils.h"
+
+// Names used for a IceCandidate JSON object.
+const char kCandidateSdpMidName[] = "sdpMid";
+const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
+const char kCandidateSdpName[] = "candidate";
+
+// Names used for a SessionDescription JSON object.
+const char kSessionDescriptionTypeName[] = "type";
+const char kSessionDescriptionSdpName[] = "sdp";
+
+#define DTLS_ON  true
+#define DTLS_OFF false
+
+namespace {
+
+// Whether the connection address of a candidate attribute, the fifth
+// field of "candidate:<foundation> <component> <transport> <priority>
+// <address> <port> typ <type>...", is |ip|.
+bool CandidateAddressIs(const std::string& line, const rtc::IPAddress& ip) {
+  size_t pos = 0;
+  for (int field = 0; field < 4; field++) {
+    pos = line.find(' ', pos);
+    if (pos == std::string::npos)
+      return false;
+    pos++;
+  }
+  size_t end = line.find_first_of(" \r", pos);
+  rtc::IPAddress address;
+  return rtc::IPFromString(line.substr(pos, end - pos), &address) &&
+         address == ip;
+}
+
+// Adds the session level ICE-lite attribute and drops the candidates that
+// are not on the listen IP, false if none is left.
+bool MakeIceLiteAnswer(const std::string& sdp, const rtc::IPAddress& listen_ip,
+                       std::string* lite) {
+  lite->clear();
+  lite->reserve(sdp.size() + 16);
+  int candidates = 0;
+  size_t pos = 0;
+  while (pos < sdp.size()) {
+    size_t eol = sdp.find("\r\n", pos);
+    size_t next = eol == std::string::npos ? sdp.size() : eol + 2;
+    std::string line = sdp.substr(pos, next - pos);
+    pos = next;
+    if (line.compare(0, 12, "a=candidate:") == 0) {
+      if (!CandidateAddressIs(line, listen_ip))
+        continue;
+      candidates++;
+    }
+    *lite += line;
+    // Session attributes follow the timing line.
+    if (line.compare(0, 2, "t=") == 0)
+      *lite += "a=ice-lite\r\n";
+  }
+  return candidates > 0;
+}
+
+}  // namespace
+
+// Reports the result of setting a description back to its session, which
+// it keeps alive until then.
+class SetDescriptionObserver
+    : public webrtc::SetSessionDescriptionObserver {
+ public:
+  static SetDescriptionObserver* Create(Session* session, bool remote) {
+    return
+        new rtc::RefCountedObject<SetDescriptionObserver>(session, remote);
+  }
+  virtual void OnSuccess() {
+    RTC_LOG(INFO) << __FUNCTION__;
+    session_->OnSetDescription(remote_, true, "");
+  }
+  virtual void OnFailure(const std::string& error) {
+    RTC_LOG(INFO) << __FUNCTION__ << " " << error;
+    session_->OnSetDescription(remote_, false, error);
+  }
+
+ protected:
+  SetDescriptionObserver(Session* session, bool remote)
+    : session_(session), remote_(remote) {}
+  ~SetDescriptionObserver() {}
+
+  rtc::scoped_refptr<Session> session_;
+  bool remote_;
+};
+
+SessionConfig::SessionConfig()
+  : ice_gathering(ICE_GATHERING_LISTEN_IP),
+    ice_gathering_timeout_ms(0),
+    ice_lite(false),
+    min_port(0),
+    max_port(0),
+    ice_candidate_pool_size(0),
+    certificate_pool(NULL),
+    media_security(MEDIA_SECURITY_DTLS),
+    offer_timeout_ms(0),
+    ice_disconnected_timeout_ms(0),
+    media_timeout_ms(0),
+    max_duration_s(0),
+    recording_writers(NULL),
+    recording_dir("/audio") {
+}
+
+SessionTimings::SessionTimings()
+  : offer_ms(0),
+    answer_created_ms(0),
+    first_candidate_ms(0),
+    gathering_complete_ms(0),
+    answer_sent_ms(0),
+    ice_connected_ms(0),
+    timed_out(false) {
+}
+
+Session::Session(int id, SessionObserver* observer,
+                 const SessionConfig& config, int shard,
+                 webrtc::PeerConnectionFactoryInterface* factory,
+                 rtc::NetworkManager* network_manager)
+  : id_(id),
+    observer_(observer),
+    config_(config),
+    signaling_thread_(rtc::Thread::Current()),
+    shard_(shard),
+    media_security_(config.media_security),
+    answer_created_(false),
+    answer_sent_(false),
+    receiving_(false),
+    closed_(false),
+    peer_connection_factory_(factory),
+    network_manager_(network_manager) {
+  rtc::IPFromString(config_.listen_ip, &listen_ip_);
+}
+
+Session::~Session() {
+  RTC_DCHECK(peer_connection_.get() == NULL);
+  signaling_thread_->Clear(this);
+}
+
+bool Session::ParseIceGatheringPolicy(const std::string& name,
+                                      IceGatheringPolicy* policy) {
+  if (name == "host") {
+    *policy = ICE_GATHERING_HOST;
+  } else if (name == "listen_ip") {
+    *policy = ICE_GATHERING_LISTEN_IP;
+  } else if (name == "complete") {
+    *policy = ICE_GATHERING_COMPLETE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool Session::connection_active() const {
+  return peer_connection_.get() != NULL;
+}
+
+bool Session::ParseMediaSecurity(const std::string& name,
+                                 MediaSecurity* security) {
+  if (name == "dtls") {
+    *security = MEDIA_SECURITY_DTLS;
+  } else if (name == "sdes") {
+    *security = MEDIA_SECURITY_SDES;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* Session::MediaSecurityName(MediaSecurity security) {
+  switch (security) {
+    case MEDIA_SECURITY_DTLS:
+      return "dtls";
+    case MEDIA_SECURITY_SDES:
+      return "sdes";
+    default:
+      return "unknown";
+  }
+}
+
+const char* Session::EndReasonName(SessionEndReason reason) {
+  switch (reason) {
+    case SESSION_END_INVALID_OFFER:
+      return "invalid_offer";
+    case SESSION_END_ANSWER_FAILED:
+      return "answer_failed";
+    case SESSION_END_OFFER_TIMEOUT:
+      return "offer_timeout";
+    case SESSION_END_ICE_FAILED:
+      return "ice_failed";
+    case SESSION_END_ICE_DISCONNECTED:
+      return "ice_disconnected";
+    case SESSION_END_MEDIA_TIMEOUT:
+      return "media_timeout";
+    case SESSION_END_MAX_DURATION:
+      return "max_duration";
+    default:
+      return "unknown";
+  }
+}
+
+void Session::set_media_security(MediaSecurity security) {
+  RTC_DCHECK(peer_connection_.get() == NULL);
+  media_security_ = security;
+}
+
+void Session::Close() {
+  closed_ = true;
+  signaling_thread_->Clear(this);
+}
+
+void Session::Teardown() {
+  Close();
+  DeletePeerConnection();
+}
+
+void Session::OnSetDescription(bool remote, bool success,
+                               const std::string& error) {
+  if (success)
+    return;
+  RTC_LOG(LS_ERROR) << __FUNCTION__ << " session:" << id_ << " failed to set "
+                    << (remote ? "the offer: " : "the answer: ") << error;
+  // A rejected offer is the client's fault, a rejected answer is ours.
+  End(remote ? SESSION_END_INVALID_OFFER : SESSION_END_ANSWER_FAILED);
+}
+
+void Session::OnMessage(rtc::Message* msg) {
+  switch (msg->message_id) {
+    case MSG_GATHERING_TIMEOUT:
+      if (answer_sent_ || !answer_created_)
+        break;
+      RTC_LOG(WARNING) << __FUNCTION__ << " session:" << id_
+                       << " gathering timeout, answering with the candidates"
+                       << " gathered so far";
+      timings_.timed_out = true;
+      SendAnswer();
+      break;
+    case MSG_OFFER_TIMEOUT:
+      if (!answer_sent_)
+        End(SESSION_END_OFFER_TIMEOUT);
+      break;
+    case MSG_ICE_DISCONNECTED_TIMEOUT:
+      End(SESSION_END_ICE_DISCONNECTED);
+      break;
+    case MSG_MEDIA_TIMEOUT:
+      End(SESSION_END_MEDIA_TIMEOUT);
+      break;
+    case MSG_MAX_DURATION:
+      End(SESSION_END_MAX_DURATION);
+      break;
+    default:
+      RTC_NOTREACHED();
+      break;
+  }
+}
+
+void Session::SendAnswer() {
+  RTC_DCHECK(answer_created_);
+  RTC_DCHECK(!answer_sent_);
+  // Owned by the PeerConnection, it holds the candidates gathered so far.
+  const webrtc::SessionDescriptionInterface* desc =
+      peer_connection_->local_description();
+  if (!desc) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << " session:" << id_
+                      << " no local description";
+    End(SESSION_END_ANSWER_FAILED);
+    return;
+  }
+  std::string sdp;
+  desc->ToString(&sdp);
+  if (config_.ice_lite) {
+    std::string lite;
+    if (!MakeIceLiteAnswer(sdp, listen_ip_, &lite)) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " session:" << id_
+                        << " no candidate on " << config_.listen_ip;
+      End(SESSION_END_ANSWER_FAILED);
+      return;
+    }
+    sdp.swap(lite);
+  }
+  answer_sent_ = true;
+  timings_.answer_sent_ms = rtc::TimeMillis();
+  signaling_thread_->Clear(this, MSG_GATHERING_TIMEOUT);
+  signaling_thread_->Clear(this, MSG_OFFER_TIMEOUT);
+  // The call starts, from now on a vanished client is detected.
+  if (config_.media_timeout_ms > 0 && !receiving_) {
+    signaling_thread_->PostDelayed(RTC_FROM_HERE, config_.media_timeout_ms,
+                                   this, MSG_MEDIA_TIMEOUT);
+  }
+  if (config_.max_duration_s > 0) {
+    signaling_thread_->PostDelayed(RTC_FROM_HERE,
+                                   config_.max_duration_s * 1000, this,
+                                   MSG_MAX_DURATION);
+  }
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id_ << " after "
+                << timings_.answer_sent_ms - timings_.offer_ms << "ms"
+                << " (create answer:"
+                << timings_.answer_created_ms - timings_.offer_ms << "ms"
+                << " gathering:"
+                << timings_.answer_sent_ms - timings_.answer_created_ms
+                << "ms)";
+  observer_->OnSessionAnswer(id_, sdp);
+}
+
+void Session::End(SessionEndReason reason) {
+  if (closed_)
+    return;
+  RTC_LOG(WARNING) << __FUNCTION__ << " session:" << id_ << " reason:"
+                   << EndReasonName(reason);
+  observer_->OnSessionEnded(id_, reason);
+}
+
+bool Session::Prepare() {
+  if (peer_connection_.get())
+    return true;
+  return InitializePeerConnection();
+}
+
+bool Session::InitializePeerConnection() {
+  RTC_DCHECK(peer_connection_factory_.get() != NULL);
+  RTC_DCHECK(peer_connection_.get() == NULL);
+
+  if (!CreatePeerConnection(media_security_ == MEDIA_SECURITY_DTLS ?
+                            DTLS_ON : DTLS_OFF)) {
+    RTC_LOG(INFO) << "Error: CreatePeerConnection failed";
+    DeletePeerConnection();
+    return false;
+  }
+  AddStreams();
+  return peer_connection_.get() != NULL;
+}
+
+bool Session::CreatePeerConnection(bool dtls) {
+  RTC_DCHECK(peer_connection_factory_.get() != NULL);
+  RTC_DCHECK(peer_connection_.get() == NULL);
+
+  webrtc::PeerConnectionInterface::RTCConfiguration config;
+  config.audio_jitter_buffer_max_packets = 100;
+  config.audio_jitter_buffer_fast_accelerate = true;
+  RTC_LOG(INFO) << "config.audio_jitter_buffer_fast_accelerate: " << config.audio_jitter_buffer_fast_accelerate;
+
+  config.ice_candidate_pool_size = config_.ice_candidate_pool_size;
+  config.port_allocator_config.min_port = config_.min_port;
+  config.port_allocator_config.max_port = config_.max_port;
+  std::unique_ptr<cricket::PortAllocator> allocator;
+  if (config_.ice_lite) {
+    // UDP host candidates only, on the listen IP whatever interface
+    // carries the default route: the NetworkManager exposes that address
+    // alone.
+    RTC_DCHECK(network_manager_);
+    config.port_allocator_config.flags =
+        cricket::PORTALLOCATOR_DISABLE_STUN |
+        cricket::PORTALLOCATOR_DISABLE_RELAY |
+        cricket::PORTALLOCATOR_DISABLE_TCP;
+    config.tcp_candidate_policy =
+        webrtc::PeerConnectionInterface::kTcpCandidatePolicyDisabled;
+    allocator.reset(new cricket::BasicPortAllocator(network_manager_));
+    allocator->set_flags(config.port_allocator_config.flags);
+    allocator->SetPortRange(config_.min_port, config_.max_port);
+  } else {
+    webrtc::PeerConnectionInterface::IceServer server;
+    server.uri = GetPeerConnectionString();
+    config.servers.push_back(server);
+  }
+
+  if (dtls && config_.certificate_pool) {
+    rtc::scoped_refptr<rtc::RTCCertificate> certificate =
+        config_.certificate_pool->Next();
+    if (certificate)
+      config.certificates.push_back(certificate);
+  }
+
+  webrtc::FakeConstraints constraints;
+  if (dtls) {
+    constraints.AddOptional(webrtc::MediaConstraintsInterface::kEnableDtlsSrtp,
+                            "true");
+    RTC_LOG(INFO) << __FUNCTION__ << " DTLS constraint: true ";
+  } else {
+    constraints.AddOptional(webrtc::MediaConstraintsInterface::kEnableDtlsSrtp,
+                            "false");
+    RTC_LOG(INFO) << __FUNCTION__ << " DTLS constraint: false ";
+  }
+  constraints.AddOptional(webrtc::MediaConstraintsInterface::kOfferToReceiveVideo,
+                            "false");
+  RTC_LOG(INFO) << __FUNCTION__ << " offer receive video: false ";
+  peer_connection_ = peer_connection_factory_->CreatePeerConnection(
+      config, &constraints, std::move(allocator), NULL, this);
+  return peer_connection_.get() != NULL;
+}
+
+void Session::DeletePeerConnection() {
+  StopRecording();
+  peer_connection_ = NULL;
+  active_streams_.clear();
+}
+
+void Session::StartRecording(webrtc::AudioTrackInterface* track) {
+  if (!config_.recording_writers || recorder_)
+    return;
+  // Always prefixed by the session id: a client chosen name can not match
+  // a mixed recording nor the file of another live session.
+  std::string name = "session_" + std::to_string(id_);
+  if (!recording_name_.empty())
+    name += "_" + recording_name_;
+  std::string filename = config_.recording_dir + "/" + name + ".raw";
+  std::unique_ptr<SessionRecorder> recorder(
+      new SessionRecorder(config_.recording_writers));
+  if (!recorder->Open(filename))
+    return;  // The call goes on unrecorded.
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id_ << " "
+                << recorder->filename();
+  // Fed by the audio thread with the decoded frames from now on.
+  track->AddSink(recorder.get());
+  recorded_track_ = track;
+  recorder_ = std::move(recorder);
+}
+
+void Session::StopRecording() {
+  if (!recorder_)
+    return;
+  // Once removed, the sink is not called anymore.
+  recorded_track_->RemoveSink(recorder_.get());
+  recorded_track_ = NULL;
+  recorder_.reset();
+}
+
+void Session::AddStreams() {
+  if (active_streams_.find("stream_id_todo_multi_stream") != active_streams_.end())
+    return;  // Already added.
+
+  rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track(
+      peer_connection_factory_->CreateAudioTrack(
+          kAudioLabel, peer_connection_factory_->CreateAudioSource(NULL)));
+
+  rtc::scoped_refptr<webrtc::MediaStreamInterface> stream =
+      peer_connection_factory_->CreateLocalMediaStream("stream_id_todo_multi_stream");
+
+  stream->AddTrack(audio_track);
+  if (!peer_connection_->AddStream(stream)) {
+    RTC_LOG(LS_ERROR) << "Adding stream to PeerConnection failed";
+  }
+  typedef std::pair<std::string,
+                    rtc::scoped_refptr<webrtc::MediaStreamInterface> >
+      MediaStreamPair;
+  active_streams_.insert(MediaStreamPair(stream->id(), stream));
+}
+
+void Session::OnMessageFromPeer(const std::string& message) {
+  RTC_DCHECK(!message.empty());
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id_;
+  if (closed_)
+    return;
+  // Until the offer is applied, any failure is reported to the client.
+  bool offer = timings_.offer_ms == 0;
+  if (offer) {
+    timings_.offer_ms = rtc::TimeMillis();
+    if (config_.offer_timeout_ms > 0) {
+      signaling_thread_->PostDelayed(RTC_FROM_HERE, config_.offer_timeout_ms,
+                                     this, MSG_OFFER_TIMEOUT);
+    }
+  }
+
+  if (!peer_connection_.get()) {
+    if (!InitializePeerConnection()) {
+      RTC_LOG(LS_ERROR) << "Failed to initialize our PeerConnection instance";
+      End(SESSION_END_ANSWER_FAILED);
+      return;
+    } else {
+      RTC_LOG(LS_ERROR) << "Ok initialize our PeerConnection instance";
+    }
+  }
+
+  Json::Reader reader;
+  Json::Value jmessage;
+  if (!reader.parse(message, jmessage)) {
+    RTC_LOG(WARNING) << "Received unknown message. " << message;
+    if (offer)
+      End(SESSION_END_INVALID_OFFER);
+    return;
+  }
+  std::string type;
+  std::string json_object;
+
+  rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName, &type);
+  if (!type.empty()) {
+    std::string sdp;
+    if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName,
+                                      &sdp)) {
+      RTC_LOG(WARNING) << "Can't parse received session description message.";
+      if (offer)
+        End(SESSION_END_INVALID_OFFER);
+      return;
+    }
+    RTC_LOG(WARNING) <<"type["<<type<<"]sdp["<< sdp <<"]";
+    webrtc::SdpParseError error;
+    webrtc::SessionDescriptionInterface* session_description(
+        webrtc::CreateSessionDescription(type, sdp, &error));
+    if (!session_description) {
+      RTC_LOG(WARNING) << "Can't parse received session description message. "
+          << "SdpParseError was: " << error.description;
+      if (offer)
+        End(SESSION_END_INVALID_OFFER);
+      return;
+    }
+    if (offer && session_description->type() !=
+                     webrtc::SessionDescriptionInterface::kOffer) {
+      RTC_LOG(WARNING) << "Expected an offer, received:" << type;
+      delete session_description;
+      End(SESSION_END_INVALID_OFFER);
+      return;
+    }
+    RTC_LOG(INFO) << " Received session description :" << message;
+    bool is_offer = session_description->type() ==
+        webrtc::SessionDescriptionInterface::kOffer;
+    peer_connection_->SetRemoteDescription(
+        SetDescriptionObserver::Create(this, true), session_description);
+    RTC_LOG(INFO) << " remote description set !";
+    if (is_offer) {
+      peer_connection_->CreateAnswer(this, NULL);
+      RTC_LOG(INFO) << " Answer created !";
+    }
+    return;
+  } else {
+    std::string sdp_mid;
+    int sdp_mlineindex = 0;
+    std::string sdp;
+    if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName,
+                                      &sdp_mid) ||
+        !rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName,
+                                   &sdp_mlineindex) ||
+        !rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp)) {
+      RTC_LOG(WARNING) << "Can't parse received message.";
+      if (offer)
+        End(SESSION_END_INVALID_OFFER);
+      return;
+    }
+    if (offer) {
+      RTC_LOG(WARNING) << "Expected an offer, received a candidate";
+      End(SESSION_END_INVALID_OFFER);
+      return;
+    }
+    webrtc::SdpParseError error;
+    std::unique_ptr<webrtc::IceCandidateInterface> candidate(
+        webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
+    if (!candidate.get()) {
+      RTC_LOG(WARNING) << "Can't parse received candidate message. "
+          << "SdpParseError was: " << error.description;
+      return;
+    }
+    if (!peer_connection_->AddIceCandidate(candidate.get())) {
+      RTC_LOG(WARNING) << "Failed to apply the received candidate";
+      return;
+    }
+    RTC_LOG(INFO) << " Received candidate :" << message;
+    return;
+  }
+}
+
+//
+// PeerConnectionObserver implementation.
+//
+
+// Called when a remote stream is added
+void Session::OnAddStream(
+    rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
+    RTC_LOG(INFO) << __FUNCTION__ << " " << stream->id();
+    webrtc::AudioTrackVector tracks = stream->GetAudioTracks();
+    if (!tracks.empty())
+      StartRecording(tracks[0]);
+}
+
+void Session::OnRemoveStream(
+    rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
+    RTC_LOG(INFO) << __FUNCTION__ << " " << stream->id();
+}
+
+void Session::OnIceConnectionChange(
+    webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id_ << " state:"
+                << new_state;
+  if (closed_)
+    return;
+  switch (new_state) {
+    case webrtc::PeerConnectionInterface::kIceConnectionConnected:
+    case webrtc::PeerConnectionInterface::kIceConnectionCompleted:
+      signaling_thread_->Clear(this, MSG_ICE_DISCONNECTED_TIMEOUT);
+      if (timings_.ice_connected_ms == 0) {
+        timings_.ice_connected_ms = rtc::TimeMillis();
+        observer_->OnSessionConnected(id_);
+      }
+      break;
+    case webrtc::PeerConnectionInterface::kIceConnectionDisconnected:
+      // May come back on its own, a network change for instance.
+      if (config_.ice_disconnected_timeout_ms > 0) {
+        signaling_thread_->Clear(this, MSG_ICE_DISCONNECTED_TIMEOUT);
+        signaling_thread_->PostDelayed(RTC_FROM_HERE,
+                                       config_.ice_disconnected_timeout_ms,
+                                       this, MSG_ICE_DISCONNECTED_TIMEOUT);
+      }
+      break;
+    case webrtc::PeerConnectionInterface::kIceConnectionFailed:
+      End(SESSION_END_ICE_FAILED);
+      break;
+    default:
+      break;
+  }
+}
+
+void Session::OnIceConnectionReceivingChange(bool receiving) {
+  RTC_LOG(INFO) << __FUNCTION__ << " session:" << id_ << " receiving:"
+                << receiving;
+  receiving_ = receiving;
+  if (closed_ || !answer_sent_ || config_.media_timeout_ms <= 0)
+    return;
+  signaling_thread_->Clear(this, MSG_MEDIA_TIMEOUT);
+  if (!receiving) {
+    signaling_thread_->PostDelayed(RTC_FROM_HERE, config_.media_timeout_ms,
+                                   this, MSG_MEDIA_TIMEOUT);
+  }
+}
+
+void Session::OnIceGatheringChange(
+    webrtc::PeerConnectionInterface::IceGatheringState new_state) {
+
+    RTC_LOG(INFO) << __FUNCTION__ << " ? " << webrtc::PeerConnectionInterface::kIceGatheringComplete << " == " << new_state;
+    if (closed_ ||
+        new_state != webrtc::PeerConnectionInterface::kIceGatheringComplete)
+      return;
+    timings_.gathering_complete_ms = rtc::TimeMillis();
+    // Whatever the policy, nothing more will come.
+    if (!answer_sent_ && answer_created_)
+      SendAnswer();
+    if (answer_sent_)
+      observer_->OnSessionCandidate(id_, "");
+};
+
+void Session::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
+    RTC_LOG(WARNING) << __FUNCTION__ << " " << candidate->sdp_mline_index();
+
+    std::string sdp;
+    if (!candidate->ToString(&sdp)) {
+        RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
+        return;
+    } else {
+        RTC_LOG(WARNING) << "Ice Candidate:" << sdp;
+    }
+
+    if (closed_)
+       return;
+    if (timings_.first_candidate_ms == 0)
+       timings_.first_candidate_ms = rtc::TimeMillis();
+    bool on_listen_ip =
+        candidate->candidate().address().ipaddr() == listen_ip_;
+    if (config_.ice_lite && !on_listen_ip)
+       return;
+    if (answer_sent_) {
+       // Too late for the answer SDP, trickled instead.
+       Json::Value jmessage;
+       jmessage[kCandidateSdpMidName] = candidate->sdp_mid();
+       jmessage[kCandidateSdpMlineIndexName] = candidate->sdp_mline_index();
+       jmessage[kCandidateSdpName] = sdp;
+       Json::FastWriter writer;
+       observer_->OnSessionCandidate(id_, writer.write(jmessage));
+       return;
+    }
+    if (!answer_created_)
+       return;
+
+    switch (config_.ice_gathering) {
+      case ICE_GATHERING_HOST:
+        if (sdp.find(" typ host") != std::string::npos)
+          SendAnswer();
+        break;
+      case ICE_GATHERING_LISTEN_IP:
+        if (on_listen_ip) {
+          RTC_LOG(WARNING) << "main "<< config_.listen_ip <<" Ice Candidate:" << sdp;
+          SendAnswer();
+        }
+        break;
+      case ICE_GATHERING_COMPLETE:
+        break;  // See OnIceGatheringChange().
+    }
+}
+
+//
+// CreateSessionDescriptionObserver implementation.
+//
+
+void Session::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
+  if (closed_) {
+    delete desc;
+    return;
+  }
+  peer_connection_->SetLocalDescription(
+      SetDescriptionObserver::Create(this, false), desc);
+  answer_created_ = true;
+  timings_.answer_created_ms = rtc::TimeMillis();
+  RTC_LOG(INFO) << __FUNCTION__ << " success SDP answer waiting for ICE candidate" ;
+  if (config_.ice_gathering_timeout_ms > 0) {
+    signaling_thread_->PostDelayed(RTC_FROM_HERE,
+                                   config_.ice_gathering_timeout_ms, this,
+                                   MSG_GATHERING_TIMEOUT);
+  }
+}
+
+void Session::OnFailure(const std::string& error) {
+  RTC_LOG(LERROR) << __FUNCTION__ << " session:" << id_ << " " << error;
+  End(SESSION_END_ANSWER_FAILED);
+}
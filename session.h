@@ -0,0 +1,263 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_SESSION_H_
+#define PEERCONNECTION_SESSION_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "api/mediastreaminterface.h"
+#include "api/peerconnectioninterface.h"
+#include "examples/rtc_gw/certificate_pool.h"
+#include "examples/rtc_gw/session_recorder.h"
+#include "rtc_base/ipaddress.h"
+#include "rtc_base/messagehandler.h"
+#include "rtc_base/network.h"
+#include "rtc_base/thread.h"
+
+// When the answer leaves, the candidates gathered so far are in its SDP.
+enum IceGatheringPolicy {
+  // At the first host candidate, no server reflexive round-trip.
+  ICE_GATHERING_HOST,
+  // At the first candidate on the listen IP.
+  ICE_GATHERING_LISTEN_IP,
+  // Once gathering is complete.
+  ICE_GATHERING_COMPLETE,
+};
+
+// How the media of a session is keyed.
+enum MediaSecurity {
+  // DTLS-SRTP, keys negotiated on the media path.
+  MEDIA_SECURITY_DTLS,
+  // SDES, keys exchanged in the SDP, for trusted internal legs.
+  MEDIA_SECURITY_SDES,
+  MEDIA_SECURITY_COUNT,
+};
+
+// Why a session ended without a BYE.
+enum SessionEndReason {
+  // The offer could not be parsed or applied, the client's fault.
+  SESSION_END_INVALID_OFFER,
+  // The PeerConnection or the answer could not be created.
+  SESSION_END_ANSWER_FAILED,
+  // No answer before the offer deadline.
+  SESSION_END_OFFER_TIMEOUT,
+  // ICE failed, the client is unreachable.
+  SESSION_END_ICE_FAILED,
+  // ICE stayed disconnected longer than the grace period.
+  SESSION_END_ICE_DISCONNECTED,
+  // Nothing received on the media transport for too long.
+  SESSION_END_MEDIA_TIMEOUT,
+  // The call reached the maximum duration.
+  SESSION_END_MAX_DURATION,
+  SESSION_END_REASON_COUNT,
+};
+
+// Settings shared by every session.
+struct SessionConfig {
+  SessionConfig();
+
+  std::string listen_ip;
+  IceGatheringPolicy ice_gathering;
+  // Upper bound on the wait for candidates, 0 waits as long as it takes.
+  int ice_gathering_timeout_ms;
+  // Host candidates on the listen IP only, no STUN, and the answer
+  // advertises ICE-lite.
+  bool ice_lite;
+  // Local UDP port range, 0 lets the system pick.
+  int min_port;
+  int max_port;
+  // ICE candidates gathered as soon as the PeerConnection exists, before
+  // the offer.
+  int ice_candidate_pool_size;
+  // DTLS certificates handed to the sessions, NULL to let each
+  // PeerConnection generate its own.
+  CertificatePool* certificate_pool;
+  // Used when the offer does not ask for a mode.
+  MediaSecurity media_security;
+  // Time from the offer to the answer before the session fails, 0 waits
+  // as long as it takes.
+  int offer_timeout_ms;
+  // Time ICE may stay disconnected before the session ends, 0 waits for
+  // it to fail instead.
+  int ice_disconnected_timeout_ms;
+  // Time without packets on the media transport, once the answer is sent,
+  // before the session ends, 0 disables it.
+  int media_timeout_ms;
+  // Call duration from the answer, 0 for no limit.
+  int max_duration_s;
+  // Writes the remote audio of each session, NULL to not record them.
+  AudioWriterThread* recording_writers;
+  // Where the session recordings are created.
+  std::string recording_dir;
+};
+
+// Milliseconds timestamps of the answer phases, 0 until reached.
+struct SessionTimings {
+  SessionTimings();
+
+  int64_t offer_ms;
+  int64_t answer_created_ms;
+  int64_t first_candidate_ms;
+  int64_t gathering_complete_ms;
+  int64_t answer_sent_ms;
+  int64_t ice_connected_ms;
+  // The gathering timeout sent the answer.
+  bool timed_out;
+};
+
+struct SessionObserver {
+  // Called once the local answer and the candidates required by the
+  // gathering policy are ready.
+  virtual void OnSessionAnswer(int session_id, const std::string& sdp) = 0;
+  // Called for each local candidate gathered once the answer is sent, in
+  // JSON form, and with an empty |candidate| at the end of gathering.
+  virtual void OnSessionCandidate(int session_id,
+                                  const std::string& candidate) = 0;
+  // Called when ICE first connects.
+  virtual void OnSessionConnected(int session_id) = 0;
+  // Called when the session has to end without a BYE, the observer tears
+  // it down. Before the answer is sent, the offer failed.
+  virtual void OnSessionEnded(int session_id, SessionEndReason reason) = 0;
+
+ protected:
+  virtual ~SessionObserver() {}
+};
+
+// One call: a PeerConnection and its pending answer, identified by the id
+// the listener generated when the offer arrived.
+class Session
+  : public webrtc::PeerConnectionObserver,
+    public webrtc::CreateSessionDescriptionObserver,
+    public rtc::MessageHandler {
+
+ public:
+  // Longest call duration, in milliseconds it must fit a PostDelayed()
+  // delay. About 23 days.
+  static const int kMaxDurationS = 2000000;
+
+  enum MessageID {
+    MSG_GATHERING_TIMEOUT = 1,
+    MSG_OFFER_TIMEOUT,
+    MSG_ICE_DISCONNECTED_TIMEOUT,
+    MSG_MEDIA_TIMEOUT,
+    MSG_MAX_DURATION,
+  };
+
+  // |network_manager| restricts gathering to the listen IP, NULL to gather
+  // on every interface.
+  Session(int id, SessionObserver* observer, const SessionConfig& config,
+          int shard, webrtc::PeerConnectionFactoryInterface* factory,
+          rtc::NetworkManager* network_manager);
+
+  static bool ParseIceGatheringPolicy(const std::string& name,
+                                      IceGatheringPolicy* policy);
+  static bool ParseMediaSecurity(const std::string& name,
+                                 MediaSecurity* security);
+  static const char* MediaSecurityName(MediaSecurity security);
+  static const char* EndReasonName(SessionEndReason reason);
+
+  int id() const { return id_; }
+  // Pre-warmed sessions are created without an id.
+  void set_id(int id) { id_ = id; }
+  int shard() const { return shard_; }
+  MediaSecurity media_security() const { return media_security_; }
+  // Must be called before the PeerConnection is created.
+  void set_media_security(MediaSecurity security);
+  // Appended to "session_<id>" in the file name of the recording, must be
+  // set before the offer.
+  void set_recording_name(const std::string& name) { recording_name_ = name; }
+  const SessionTimings& timings() const { return timings_; }
+  bool connection_active() const;
+
+  // Creates the PeerConnection ahead of the offer.
+  bool Prepare();
+  // Handles an offer or a remote candidate in JSON form.
+  void OnMessageFromPeer(const std::string& message);
+  // Stops reporting to the observer, cheap. The PeerConnection stays until
+  // Teardown().
+  void Close();
+  // Closes and releases the PeerConnection, transports included.
+  void Teardown();
+  // Result of SetRemoteDescription() or SetLocalDescription().
+  void OnSetDescription(bool remote, bool success, const std::string& error);
+
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
+ protected:
+  ~Session();
+  bool InitializePeerConnection();
+  bool CreatePeerConnection(bool dtls);
+  void DeletePeerConnection();
+  void AddStreams();
+  // Records the remote audio |track| if sessions are recorded.
+  void StartRecording(webrtc::AudioTrackInterface* track);
+  void StopRecording();
+  // Sends the answer with the candidates gathered so far.
+  void SendAnswer();
+  // Reports the end of the session once, see OnSessionEnded().
+  void End(SessionEndReason reason);
+
+  // PeerConnectionObserver implementation.
+  void OnSignalingChange(
+      webrtc::PeerConnectionInterface::SignalingState new_state) override{};
+  void OnAddStream(
+      rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) override;
+  void OnRemoveStream(
+      rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) override;
+  void OnDataChannel(
+      rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
+  void OnRenegotiationNeeded() override {}
+  void OnIceConnectionChange(
+      webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
+  void OnIceGatheringChange(
+      webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
+  void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
+  void OnIceConnectionReceivingChange(bool receiving) override;
+
+  // CreateSessionDescriptionObserver implementation.
+  void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
+  void OnFailure(const std::string& error) override;
+
+  int id_;
+  SessionObserver* observer_;
+  SessionConfig config_;
+  rtc::Thread* signaling_thread_;
+  int shard_;
+  MediaSecurity media_security_;
+  // The answer is the PeerConnection local description once created.
+  bool answer_created_;
+  bool answer_sent_;
+  // Packets arrive on the selected ICE connection.
+  bool receiving_;
+  bool closed_;
+  SessionTimings timings_;
+  rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+  // Factory of the shard the session was placed on.
+  rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+      peer_connection_factory_;
+  rtc::NetworkManager* network_manager_;
+  // |config_.listen_ip| parsed, candidates are compared to it.
+  rtc::IPAddress listen_ip_;
+  std::map<std::string, rtc::scoped_refptr<webrtc::MediaStreamInterface> >
+      active_streams_;
+  std::string recording_name_;
+  // Sink of |recorded_track_|, removed before the PeerConnection goes.
+  std::unique_ptr<SessionRecorder> recorder_;
+  rtc::scoped_refptr<webrtc::AudioTrackInterface> recorded_track_;
+};
+
+#endif  // PEERCONNECTION_SESSION_H_
@@ -0,0 +1,107 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/session_pool.h"
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/thread.h"
+
+SessionPool::SessionPool(SessionObserver* observer,
+                         PeerConnectionFactoryPool* factory_pool)
+  : observer_(observer),
+    factory_pool_(factory_pool),
+    size_(0),
+    refill_pending_(false),
+    hits_(0),
+    misses_(0) {
+}
+
+SessionPool::~SessionPool() {
+  Clear();
+}
+
+void SessionPool::Init(size_t size, const SessionConfig& config) {
+  config_ = config;
+  size_ = size;
+  RTC_LOG(INFO) << __FUNCTION__ << " size:" << size_;
+  ScheduleRefill();
+}
+
+void SessionPool::Clear() {
+  rtc::Thread::Current()->Clear(this);
+  refill_pending_ = false;
+  size_ = 0;
+  while (!ready_.empty()) {
+    ready_.front()->Teardown();
+    factory_pool_->Release(ready_.front()->shard());
+    ready_.pop_front();
+  }
+}
+
+rtc::scoped_refptr<Session> SessionPool::Acquire(int session_id,
+                                                 MediaSecurity security) {
+  rtc::scoped_refptr<Session> session;
+  if (security != config_.media_security) {
+    session = CreateSession(session_id);
+    session->set_media_security(security);
+    return session;
+  }
+  if (!ready_.empty()) {
+    session = ready_.front();
+    ready_.pop_front();
+    session->set_id(session_id);
+    hits_++;
+  } else {
+    session = CreateSession(session_id);
+    if (size_ > 0)
+      misses_++;
+  }
+  ScheduleRefill();
+  return session;
+}
+
+rtc::scoped_refptr<Session> SessionPool::CreateSession(int session_id) {
+  int shard = factory_pool_->Acquire();
+  return new rtc::RefCountedObject<Session>(
+      session_id, observer_, config_, shard, factory_pool_->factory(shard),
+      factory_pool_->network_manager(shard));
+}
+
+void SessionPool::ScheduleRefill() {
+  if (refill_pending_ || ready_.size() >= size_)
+    return;
+  refill_pending_ = true;
+  rtc::Thread::Current()->Post(RTC_FROM_HERE, this, MSG_REFILL);
+}
+
+void SessionPool::OnMessage(rtc::Message* msg) {
+  switch (msg->message_id) {
+    case MSG_REFILL: {
+      refill_pending_ = false;
+      if (ready_.size() >= size_)
+        break;
+      // Pooled sessions get their id when claimed.
+      rtc::scoped_refptr<Session> session = CreateSession(0);
+      if (!session->Prepare()) {
+        RTC_LOG(LS_ERROR) << __FUNCTION__ << " failed to prepare a session";
+        session->Teardown();
+        factory_pool_->Release(session->shard());
+        break;
+      }
+      ready_.push_back(session);
+      ScheduleRefill();
+      break;
+    }
+    default:
+      RTC_NOTREACHED();
+      break;
+  }
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_SESSION_POOL_H_
+#define PEERCONNECTION_SESSION_POOL_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "examples/rtc_gw/peer_connection_factory_pool.h"
+#include "examples/rtc_gw/session.h"
+#include "rtc_base/messagehandler.h"
+
+// Sessions whose PeerConnection, local stream and pooled ICE candidates are
+// created ahead of the offer. An offer claims one and only pays for the
+// answer, the pool is refilled one session per posted message so offers
+// arriving meanwhile are not held behind the refill.
+class SessionPool : public rtc::MessageHandler {
+ public:
+  enum MessageID {
+    MSG_REFILL = 1,
+  };
+
+  SessionPool(SessionObserver* observer,
+              PeerConnectionFactoryPool* factory_pool);
+  ~SessionPool();
+
+  // Keeps |size| sessions ready, 0 creates every session on demand. Must be
+  // called on the signaling thread once |config| is complete.
+  void Init(size_t size, const SessionConfig& config);
+  // Closes the ready sessions and stops refilling.
+  void Clear();
+
+  // Returns a ready session renamed |session_id|, or a new one if the pool
+  // is empty. Ready sessions use the default media security, other modes
+  // always get a new session.
+  rtc::scoped_refptr<Session> Acquire(int session_id, MediaSecurity security);
+
+  size_t ready() const { return ready_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
+ protected:
+  rtc::scoped_refptr<Session> CreateSession(int session_id);
+  void ScheduleRefill();
+
+  SessionObserver* observer_;
+  PeerConnectionFactoryPool* factory_pool_;
+  SessionConfig config_;
+  size_t size_;
+  std::deque<rtc::scoped_refptr<Session> > ready_;
+  bool refill_pending_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+#endif  // PEERCONNECTION_SESSION_POOL_H_
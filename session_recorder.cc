@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/session_recorder.h"
+
+#include <ctype.h>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+
+namespace {
+
+const size_t kMaxNameLength = 64;
+
+}  // namespace
+
+SessionRecorder::SessionRecorder(AudioWriterThread* writers)
+  : writers_(writers),
+    writer_(NULL),
+    sample_rate_(0),
+    channels_(0) {
+}
+
+SessionRecorder::~SessionRecorder() {
+  // Written and closed by the writer thread, not waited for.
+  if (writer_)
+    writers_->Close(writer_);
+}
+
+bool SessionRecorder::ParseMode(const std::string& name,
+                                RecordingMode* mode) {
+  if (name == "mixed") {
+    *mode = RECORDING_MIXED;
+  } else if (name == "session") {
+    *mode = RECORDING_SESSION;
+  } else if (name == "both") {
+    *mode = RECORDING_BOTH;
+  } else if (name == "none") {
+    *mode = RECORDING_NONE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool SessionRecorder::ValidName(const std::string& name) {
+  if (name.empty() || name.size() > kMaxNameLength)
+    return false;
+  // No path separator nor dot, the name stays in the recording directory.
+  for (char c : name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_')
+      return false;
+  }
+  return true;
+}
+
+bool SessionRecorder::Open(const std::string& filename) {
+  RTC_DCHECK(!writer_);
+  writer_ = writers_->Open(filename, true);
+  return writer_ != NULL;
+}
+
+void SessionRecorder::OnData(const void* audio_data, int bits_per_sample,
+                             int sample_rate, size_t number_of_channels,
+                             size_t number_of_frames) {
+  if (bits_per_sample != 16)
+    return;
+  if (sample_rate != sample_rate_ || number_of_channels != channels_) {
+    RTC_LOG(INFO) << __FUNCTION__ << " " << writer_->filename() << " rate:"
+                  << sample_rate << " channels:" << number_of_channels;
+    sample_rate_ = sample_rate;
+    channels_ = number_of_channels;
+  }
+  writer_->Write(audio_data, number_of_frames * number_of_channels * 2);
+}
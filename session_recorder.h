@@ -0,0 +1,62 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_SESSION_RECORDER_H_
+#define PEERCONNECTION_SESSION_RECORDER_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "api/mediastreaminterface.h"
+#include "examples/rtc_gw/audio_file_writer.h"
+
+// What is written to disk.
+enum RecordingMode {
+  // The playout mix of each shard, every call of the shard blended.
+  RECORDING_MIXED,
+  // The remote audio of each session in its own file.
+  RECORDING_SESSION,
+  RECORDING_BOTH,
+  RECORDING_NONE,
+};
+
+// Records the remote audio track of one session, the decoded frames are
+// handed to an AudioFileWriter as 16 bits PCM at the rate and channel
+// count of the track.
+class SessionRecorder : public webrtc::AudioTrackSinkInterface {
+ public:
+  explicit SessionRecorder(AudioWriterThread* writers);
+  ~SessionRecorder() override;
+
+  static bool ParseMode(const std::string& name, RecordingMode* mode);
+  // A recording name from an offer, part of a file name.
+  static bool ValidName(const std::string& name);
+
+  // Creates |filename|, or a variant of it if it exists, an earlier
+  // recording is never overwritten. False on failure.
+  bool Open(const std::string& filename);
+  // The file actually created.
+  const std::string& filename() const { return writer_->filename(); }
+
+  // AudioTrackSinkInterface implementation, called on the audio thread
+  // until the sink is removed from the track.
+  void OnData(const void* audio_data, int bits_per_sample, int sample_rate,
+              size_t number_of_channels, size_t number_of_frames) override;
+
+ protected:
+  AudioWriterThread* writers_;
+  AudioFileWriter* writer_;
+  // Last format seen, logged when it changes.
+  int sample_rate_;
+  size_t channels_;
+};
+
+#endif  // PEERCONNECTION_SESSION_RECORDER_H_
@@ -0,0 +1,257 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/signaling_connection.h"
+
+#include <strings.h>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/timeutils.h"
+
+namespace {
+
+// A client not reading its responses or messages is dropped past this.
+const size_t kMaxOutputSize = 1024 * 1024;
+// Nor may it pipeline more than a maximal request behind a pending one.
+const size_t kMaxInputSize =
+    HttpRequestParser::kMaxHeaderSize + HttpRequestParser::kMaxBodySize;
+
+}  // namespace
+
+SignalingConnection::SignalingConnection(int id, rtc::AsyncSocket* socket,
+                                         SignalingConnectionObserver* observer)
+  : id_(id),
+    socket_(socket),
+    observer_(observer),
+    closed_(false),
+    closing_(false),
+    busy_(false),
+    keep_alive_(false),
+    websocket_(false),
+    requests_(0),
+    last_activity_ms_(rtc::TimeMillis()) {
+  RTC_DCHECK(socket_.get() != NULL);
+  socket_->SignalReadEvent.connect(this, &SignalingConnection::OnRead);
+  socket_->SignalWriteEvent.connect(this, &SignalingConnection::OnWrite);
+  socket_->SignalCloseEvent.connect(this, &SignalingConnection::OnClose);
+}
+
+SignalingConnection::~SignalingConnection() {
+  rtc::Thread::Current()->Clear(this);
+  if (socket_->GetState() != rtc::Socket::CS_CLOSED)
+    socket_->Close();
+}
+
+bool SignalingConnection::SendResponse(const std::string& data) {
+  if (closed_ || closing_)
+    return false;
+  bool queued = Send(data);
+  RTC_LOG(INFO) << __FUNCTION__ << " connection:" << id_ << " bytes:"
+                << data.length() << " pending:" << output_.length();
+  busy_ = false;
+  if (!keep_alive_) {
+    CloseWhenSent();
+  } else if (!input_.empty() && output_.empty()) {
+    // Pipelined requests, handled once the caller has returned. With a
+    // response still pending they are resumed when it is sent.
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this, MSG_RESUME);
+  }
+  return queued;
+}
+
+bool SignalingConnection::AcceptWebSocket(const std::string& response) {
+  RTC_DCHECK(busy_);
+  websocket_ = true;
+  keep_alive_ = true;
+  return SendResponse(response);
+}
+
+bool SignalingConnection::SendText(const std::string& message) {
+  if (!websocket_)
+    return false;
+  return SendFrame(WebSocketFrameParser::OPCODE_TEXT, message);
+}
+
+bool SignalingConnection::SendFrame(WebSocketFrameParser::Opcode opcode,
+                                    const std::string& payload) {
+  if (closed_ || closing_)
+    return false;
+  // Whole frames only, a partial one would desynchronize the peer.
+  return Send(WebSocketFrameParser::EncodeFrame(opcode, payload));
+}
+
+bool SignalingConnection::Send(const std::string& data) {
+  if (closed_)
+    return false;
+  if (output_.length() + data.length() > kMaxOutputSize) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << " connection:" << id_
+                      << " peer not reading, closing";
+    Close();
+    return false;
+  }
+  output_ += data;
+  Flush();
+  return !closed_;
+}
+
+void SignalingConnection::Flush() {
+  size_t pos = 0;
+  while (pos < output_.length()) {
+    int sent = socket_->Send(output_.data() + pos, output_.length() - pos);
+    if (sent < 0 && socket_->IsBlocking())
+      break;  // Resumed by the write event.
+    if (sent <= 0) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " connection:" << id_
+                        << " send error:" << socket_->GetError();
+      Close();
+      return;
+    }
+    pos += sent;
+  }
+  output_.erase(0, pos);
+  if (pos > 0)
+    last_activity_ms_ = rtc::TimeMillis();
+}
+
+void SignalingConnection::CloseWhenSent() {
+  closing_ = true;
+  if (output_.empty())
+    Close();
+}
+
+void SignalingConnection::Close() {
+  if (closed_)
+    return;
+  closed_ = true;
+  output_.clear();
+  socket_->Close();
+  // A local close is not signaled by the socket, report it ourselves.
+  observer_->OnConnectionClosed(this);
+}
+
+void SignalingConnection::OnMessage(rtc::Message* msg) {
+  if (msg->message_id == MSG_RESUME)
+    ProcessInput();
+}
+
+void SignalingConnection::OnWrite(rtc::AsyncSocket* socket) {
+  if (closed_ || output_.empty())
+    return;
+  Flush();
+  if (closed_ || !output_.empty())
+    return;
+  if (closing_)
+    Close();
+  else if (!busy_ && !input_.empty())
+    ProcessInput();
+}
+
+void SignalingConnection::OnRead(rtc::AsyncSocket* socket) {
+  char buffer[0xffff];
+  while (!closed_) {
+    int bytes = socket_->Recv(buffer, sizeof(buffer), nullptr);
+    if (bytes <= 0)
+      break;
+    input_.append(buffer, bytes);
+    if (input_.size() > kMaxInputSize) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " connection:" << id_
+                        << " too much unparsed input, closing";
+      Close();
+      return;
+    }
+  }
+  last_activity_ms_ = rtc::TimeMillis();
+  ProcessInput();
+}
+
+void SignalingConnection::ProcessInput() {
+  if (websocket_) {
+    ProcessFrames();
+    return;
+  }
+  size_t pos = 0;
+  // Stop at an upgrade, what follows is framed and handled on resume.
+  // Responses are not queued behind one the peer has not taken yet.
+  while (pos < input_.size() && !busy_ && !closed_ && !closing_ &&
+         !websocket_ && output_.empty()) {
+    pos += parser_.Parse(input_.data() + pos, input_.size() - pos);
+    if (parser_.error()) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " connection:" << id_
+                        << " invalid request, closing";
+      Close();
+      return;
+    }
+    if (parser_.complete()) {
+      // HTTP/1.1 is persistent unless asked otherwise, HTTP/1.0 is not
+      // unless asked.
+      std::string connection;
+      parser_.GetHeader("Connection", &connection);
+      if (parser_.version() == "HTTP/1.0")
+        keep_alive_ = strcasecmp(connection.c_str(), "keep-alive") == 0;
+      else
+        keep_alive_ = strcasecmp(connection.c_str(), "close") != 0;
+      busy_ = true;
+      requests_++;
+      observer_->OnConnectionRequest(this, parser_);
+      parser_.Reset();
+    }
+  }
+  input_.erase(0, pos);
+}
+
+void SignalingConnection::ProcessFrames() {
+  size_t pos = 0;
+  while (pos < input_.size() && !closed_ && !closing_) {
+    pos += frame_parser_.Parse(input_.data() + pos, input_.size() - pos);
+    if (frame_parser_.error()) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << " connection:" << id_
+                        << " invalid frame, closing";
+      // 1002, protocol error.
+      SendFrame(WebSocketFrameParser::OPCODE_CLOSE,
+                std::string("\x03\xea", 2));
+      CloseWhenSent();
+      return;
+    }
+    if (frame_parser_.complete()) {
+      HandleFrame();
+      frame_parser_.Reset();
+    }
+  }
+  input_.erase(0, pos);
+}
+
+void SignalingConnection::HandleFrame() {
+  switch (frame_parser_.opcode()) {
+    case WebSocketFrameParser::OPCODE_TEXT:
+    case WebSocketFrameParser::OPCODE_BINARY:
+      requests_++;
+      observer_->OnConnectionMessage(this, frame_parser_.payload());
+      break;
+    case WebSocketFrameParser::OPCODE_PING:
+      SendFrame(WebSocketFrameParser::OPCODE_PONG, frame_parser_.payload());
+      break;
+    case WebSocketFrameParser::OPCODE_CLOSE:
+      // Echo the status code and close once it is sent, no more frames
+      // are expected.
+      SendFrame(WebSocketFrameParser::OPCODE_CLOSE,
+                frame_parser_.payload().substr(0, 2));
+      CloseWhenSent();
+      break;
+    default:
+      break;  // Pong.
+  }
+}
+
+void SignalingConnection::OnClose(rtc::AsyncSocket* socket, int err) {
+  RTC_LOG(INFO) << __FUNCTION__ << " connection:" << id_ << " error:" << err;
+  Close();
+}
@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_SIGNALING_CONNECTION_H_
+#define PEERCONNECTION_SIGNALING_CONNECTION_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "examples/rtc_gw/http_request_parser.h"
+#include "examples/rtc_gw/websocket_frame_parser.h"
+#include "rtc_base/asyncsocket.h"
+#include "rtc_base/messagehandler.h"
+#include "rtc_base/sigslot.h"
+
+class SignalingConnection;
+
+struct SignalingConnectionObserver {
+  // Called for each complete request read on the connection.
+  virtual void OnConnectionRequest(SignalingConnection* connection,
+                                   const HttpRequestParser& request) = 0;
+  // Called for each text or binary message once upgraded to a WebSocket.
+  virtual void OnConnectionMessage(SignalingConnection* connection,
+                                   const std::string& message) = 0;
+  // Called once when the connection is closed by either side, the
+  // connection must not be deleted from within this callback.
+  virtual void OnConnectionClosed(SignalingConnection* connection) = 0;
+
+ protected:
+  virtual ~SignalingConnectionObserver() {}
+};
+
+// An accepted signaling socket with its own request buffer, so concurrent
+// clients never share parsing state or get each other's answers.
+//
+// With HTTP keep-alive the connection carries several requests, they are
+// answered in order: while a request waits for its response, or while that
+// response is not fully sent, the following ones stay buffered.
+//
+// What the socket does not take at once is kept and sent on the next write
+// event, a response or a frame is never cut short on the wire.
+//
+// Once upgraded to a WebSocket the connection carries messages in both
+// directions instead, it is never busy and answers pings itself.
+class SignalingConnection : public sigslot::has_slots<>,
+                            public rtc::MessageHandler {
+ public:
+  enum MessageID {
+    MSG_RESUME = 1,
+  };
+
+  // Takes ownership of |socket|.
+  SignalingConnection(int id, rtc::AsyncSocket* socket,
+                      SignalingConnectionObserver* observer);
+  ~SignalingConnection();
+
+  int id() const { return id_; }
+  bool closed() const { return closed_; }
+  // True while a request waits for its response.
+  bool busy() const { return busy_; }
+  // Whether the connection stays open after the current response.
+  bool keep_alive() const { return keep_alive_; }
+  void DisableKeepAlive() { keep_alive_ = false; }
+  bool websocket() const { return websocket_; }
+  int requests() const { return requests_; }
+  int64_t last_activity_ms() const { return last_activity_ms_; }
+
+  // Sends the response of the current request, then closes the connection
+  // once it is sent or moves on to the next buffered request.
+  bool SendResponse(const std::string& data);
+  // Sends the 101 response of the current request and switches to
+  // WebSocket framing, bytes already buffered are read as frames.
+  bool AcceptWebSocket(const std::string& response);
+  // Sends a text message, only once upgraded.
+  bool SendText(const std::string& message);
+  void Close();
+
+  // implements the MessageHandler interface
+  void OnMessage(rtc::Message* msg) override;
+
+ protected:
+  void OnRead(rtc::AsyncSocket* socket);
+  void OnWrite(rtc::AsyncSocket* socket);
+  void OnClose(rtc::AsyncSocket* socket, int err);
+  // Parses buffered input until a request is waiting for its response.
+  void ProcessInput();
+  void ProcessFrames();
+  void HandleFrame();
+  bool SendFrame(WebSocketFrameParser::Opcode opcode,
+                 const std::string& payload);
+  // Queues |data| after what is not sent yet and sends what the socket
+  // takes, false if the connection is closed.
+  bool Send(const std::string& data);
+  // Sends |output_| until the socket would block.
+  void Flush();
+  // Closes once |output_| is sent.
+  void CloseWhenSent();
+
+  int id_;
+  std::unique_ptr<rtc::AsyncSocket> socket_;
+  SignalingConnectionObserver* observer_;
+  HttpRequestParser parser_;
+  WebSocketFrameParser frame_parser_;
+  // Bytes read but not parsed yet, because a request is pending.
+  std::string input_;
+  // Bytes not taken by the socket yet.
+  std::string output_;
+  bool closed_;
+  // Nothing more is read, the connection closes once |output_| is sent.
+  bool closing_;
+  bool busy_;
+  bool keep_alive_;
+  bool websocket_;
+  int requests_;
+  int64_t last_activity_ms_;
+};
+
+#endif  // PEERCONNECTION_SIGNALING_CONNECTION_H_
@@ -0,0 +1,122 @@
+#!/bin/sh
+#
+# Soak test: offer/BYE cycles against a running rtc_gw, fails if its
+# resident memory grows with the number of calls.
+#
+# usage: soak.sh [host:port] [cycles] [max_bytes_per_cycle] [pid]
+#
+# The first cycles warm up the pools and the allocator, RSS is sampled after
+# them and at the end, once every session is torn down.
+
+ADDR=${1:-127.0.0.1:9999}
+CYCLES=${2:-5000}
+MAX_BYTES_PER_CYCLE=${3:-2048}
+PID=${4:-`pidof rtc_gw`}
+WARMUP=200
+
+if [ -z "$PID" ] || [ ! -r /proc/$PID/status ]; then
+  echo "rtc_gw is not running"
+  exit 2
+fi
+
+OFFER=`mktemp`
+trap 'rm -f $OFFER' EXIT
+# An audio only offer, answered without ICE ever connecting, the SDP lines
+# are escaped into the JSON string.
+{
+printf '{"type":"offer","sdp":"'
+printf '%s\\r\\n' \
+  'v=0' \
+  'o=- 4611731400430051336 2 IN IP4 127.0.0.1' \
+  's=-' \
+  't=0 0' \
+  'a=group:BUNDLE audio' \
+  'a=msid-semantic: WMS soak' \
+  'm=audio 9 UDP/TLS/RTP/SAVPF 111 0' \
+  'c=IN IP4 0.0.0.0' \
+  'a=rtcp:9 IN IP4 0.0.0.0' \
+  'a=ice-ufrag:soak' \
+  'a=ice-pwd:soaksoaksoaksoaksoaksoak' \
+  'a=fingerprint:sha-256 4A:AD:B9:B1:3F:82:18:3B:54:02:12:DF:3E:5D:49:6B:19:E5:7C:AB:3A:A6:0A:1F:42:B6:C9:6E:6B:2D:69:EB' \
+  'a=setup:actpass' \
+  'a=mid:audio' \
+  'a=sendrecv' \
+  'a=rtcp-mux' \
+  'a=rtpmap:111 opus/48000/2' \
+  'a=fmtp:111 minptime=10;useinbandfec=1' \
+  'a=rtpmap:0 PCMU/8000' \
+  'a=ssrc:1001 cname:soak' \
+  'a=ssrc:1001 msid:soak soak_audio'
+printf '"}'
+} > $OFFER
+
+rss_kb() {
+  awk '/^VmRSS:/ {print $2}' /proc/$PID/status
+}
+
+stat_value() {
+  curl -s "http://$ADDR/STATS" | tr -d '\r' | awk -F': ' -v key="$1" \
+    '$1 == key {print $2}'
+}
+
+# Teardown is batched, wait for it before sampling.
+wait_idle() {
+  for i in `seq 1 300`; do
+    if [ "`stat_value sessions`" = "0" ] && \
+       [ "`stat_value sessions_closing`" = "0" ]; then
+      return 0
+    fi
+    sleep 0.1
+  done
+  echo "sessions still open after 30 s"
+  return 1
+}
+
+FAILED=0
+BYE_FAILED=0
+run_cycles() {
+  for i in `seq 1 $1`; do
+    # Failed offers carry a Session-Id too, only a 200 is an answer.
+    ID=`curl -s -o /dev/null -D - --data-binary @$OFFER \
+          "http://$ADDR/OFFER" | tr -d '\r' | \
+        awk 'NR == 1 {status = $2}
+             tolower($1) == "session-id:" {id = $2}
+             END {if (status == 200) print id}'`
+    if [ -z "$ID" ]; then
+      FAILED=$((FAILED + 1))
+      continue
+    fi
+    STATUS=`curl -s -o /dev/null -w '%{http_code}' \
+              "http://$ADDR/BYE?session_id=$ID"`
+    if [ "$STATUS" != "200" ]; then
+      BYE_FAILED=$((BYE_FAILED + 1))
+    fi
+  done
+}
+
+run_cycles $WARMUP
+wait_idle || exit 1
+START_KB=`rss_kb`
+FAILED=0
+BYE_FAILED=0
+run_cycles $CYCLES
+wait_idle || exit 1
+END_KB=`rss_kb`
+
+GROWTH=$(((END_KB - START_KB) * 1024))
+PER_CYCLE=$((GROWTH / CYCLES))
+echo "cycles:$CYCLES failed:$FAILED bye failed:$BYE_FAILED rss:${START_KB}kB->${END_KB}kB" \
+     "growth per cycle:${PER_CYCLE}B (max ${MAX_BYTES_PER_CYCLE}B)"
+if [ $FAILED -eq $CYCLES ]; then
+  echo "FAIL: no offer was answered"
+  exit 1
+fi
+if [ $BYE_FAILED -gt 0 ]; then
+  echo "FAIL: some sessions were not hung up"
+  exit 1
+fi
+if [ $PER_CYCLE -gt $MAX_BYTES_PER_CYCLE ]; then
+  echo "FAIL: memory grows with the calls"
+  exit 1
+fi
+echo "PASS"
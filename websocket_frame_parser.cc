@@ -0,0 +1,202 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/rtc_gw/websocket_frame_parser.h"
+
+#include <algorithm>
+
+#include "rtc_base/base64.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/messagedigest.h"
+
+namespace {
+
+// Same limit as an HTTP body, an offer is a few KB.
+const uint64_t kMaxMessageSize = 1024 * 1024;
+const size_t kMaxControlPayload = 125;
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Header length once the first two bytes are known.
+size_t HeaderLength(uint8_t length_byte) {
+  size_t length = 2 + 4;  // Client frames are always masked.
+  if ((length_byte & 0x7f) == 126)
+    length += 2;
+  else if ((length_byte & 0x7f) == 127)
+    length += 8;
+  return length;
+}
+
+}  // namespace
+
+WebSocketFrameParser::WebSocketFrameParser()
+  : message_opcode_(OPCODE_CONTINUATION) {
+  Reset();
+}
+
+void WebSocketFrameParser::Reset() {
+  state_ = STATE_HEADER;
+  header_.clear();
+  fin_ = false;
+  frame_opcode_ = OPCODE_CONTINUATION;
+  frame_length_ = 0;
+  frame_read_ = 0;
+  opcode_ = OPCODE_CONTINUATION;
+  payload_.clear();
+}
+
+size_t WebSocketFrameParser::Parse(const char* data, size_t len) {
+  size_t used = 0;
+  while (used < len && state_ != STATE_COMPLETE && state_ != STATE_ERROR) {
+    if (state_ == STATE_HEADER) {
+      size_t needed = header_.size() < 2 ?
+          2 : HeaderLength(static_cast<uint8_t>(header_[1]));
+      size_t take = std::min(needed - header_.size(), len - used);
+      header_.append(data + used, take);
+      used += take;
+      if (header_.size() < 2 ||
+          header_.size() < HeaderLength(static_cast<uint8_t>(header_[1])))
+        continue;
+      if (!ParseHeader()) {
+        state_ = STATE_ERROR;
+        return used;
+      }
+      state_ = STATE_PAYLOAD;
+    }
+
+    // Control frames go straight to |payload_|, data frames are appended to
+    // the message being reassembled.
+    bool control = frame_opcode_ >= OPCODE_CLOSE;
+    std::string* target = control ? &payload_ : &fragments_;
+    size_t take = static_cast<size_t>(
+        std::min<uint64_t>(frame_length_ - frame_read_, len - used));
+    for (size_t i = 0; i < take; i++) {
+      target->push_back(static_cast<char>(
+          data[used + i] ^ mask_[(frame_read_ + i) % 4]));
+    }
+    used += take;
+    frame_read_ += take;
+    if (frame_read_ < frame_length_)
+      continue;
+
+    if (control) {
+      opcode_ = frame_opcode_;
+      state_ = STATE_COMPLETE;
+    } else if (fin_) {
+      opcode_ = message_opcode_;
+      payload_.swap(fragments_);
+      fragments_.clear();
+      message_opcode_ = OPCODE_CONTINUATION;
+      state_ = STATE_COMPLETE;
+    } else {
+      // Wait for the next fragment.
+      header_.clear();
+      frame_read_ = 0;
+      frame_length_ = 0;
+      state_ = STATE_HEADER;
+    }
+  }
+  return used;
+}
+
+bool WebSocketFrameParser::ParseHeader() {
+  uint8_t b0 = static_cast<uint8_t>(header_[0]);
+  uint8_t b1 = static_cast<uint8_t>(header_[1]);
+  fin_ = (b0 & 0x80) != 0;
+  frame_opcode_ = static_cast<Opcode>(b0 & 0x0f);
+  if (b0 & 0x70) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": reserved bits set";
+    return false;
+  }
+  if (!(b1 & 0x80)) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": unmasked client frame";
+    return false;
+  }
+
+  size_t pos = 2;
+  frame_length_ = b1 & 0x7f;
+  if (frame_length_ == 126 || frame_length_ == 127) {
+    size_t bytes = frame_length_ == 126 ? 2 : 8;
+    frame_length_ = 0;
+    for (size_t i = 0; i < bytes; i++)
+      frame_length_ = (frame_length_ << 8) | static_cast<uint8_t>(header_[pos++]);
+    // RFC 6455 5.2, the most significant bit of a 64 bits length is 0.
+    if (frame_length_ >> 63) {
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": invalid length";
+      return false;
+    }
+  }
+  for (size_t i = 0; i < 4; i++)
+    mask_[i] = static_cast<uint8_t>(header_[pos++]);
+
+  switch (frame_opcode_) {
+    case OPCODE_CLOSE:
+    case OPCODE_PING:
+    case OPCODE_PONG:
+      if (!fin_ || frame_length_ > kMaxControlPayload) {
+        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": invalid control frame";
+        return false;
+      }
+      payload_.clear();
+      return true;
+    case OPCODE_TEXT:
+    case OPCODE_BINARY:
+      if (message_opcode_ != OPCODE_CONTINUATION) {
+        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": unfinished fragmented message";
+        return false;
+      }
+      message_opcode_ = frame_opcode_;
+      break;
+    case OPCODE_CONTINUATION:
+      if (message_opcode_ == OPCODE_CONTINUATION) {
+        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": unexpected continuation";
+        return false;
+      }
+      break;
+    default:
+      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": unknown opcode:" << frame_opcode_;
+      return false;
+  }
+  // Not as a sum, which a huge length would wrap around.
+  if (frame_length_ > kMaxMessageSize - fragments_.size()) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": message too large";
+    return false;
+  }
+  fragments_.reserve(fragments_.size() + static_cast<size_t>(frame_length_));
+  return true;
+}
+
+std::string WebSocketFrameParser::EncodeFrame(Opcode opcode,
+                                              const std::string& payload) {
+  std::string frame;
+  frame.reserve(payload.size() + 10);
+  frame.push_back(static_cast<char>(0x80 | opcode));
+  uint64_t length = payload.size();
+  if (length < 126) {
+    frame.push_back(static_cast<char>(length));
+  } else if (length <= 0xffff) {
+    frame.push_back(static_cast<char>(126));
+    frame.push_back(static_cast<char>(length >> 8));
+    frame.push_back(static_cast<char>(length));
+  } else {
+    frame.push_back(static_cast<char>(127));
+    for (int shift = 56; shift >= 0; shift -= 8)
+      frame.push_back(static_cast<char>(length >> shift));
+  }
+  frame += payload;
+  return frame;
+}
+
+std::string WebSocketFrameParser::ComputeAcceptKey(const std::string& key) {
+  std::string input = key + kWebSocketGuid;
+  char digest[20];
+  size_t length = rtc::ComputeDigest(rtc::DIGEST_SHA_1, input.data(),
+                                     input.size(), digest, sizeof(digest));
+  return rtc::Base64::Encode(std::string(digest, length));
+}
@@ -0,0 +1,79 @@
+/*
+ *  Copyright 2017-2018 Julien Chavanton
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PEERCONNECTION_WEBSOCKET_FRAME_PARSER_H_
+#define PEERCONNECTION_WEBSOCKET_FRAME_PARSER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+// Resumable RFC 6455 frame parser for the server side of a WebSocket. Like
+// the HTTP parser, bytes are fed as they are read and a frame split over
+// many reads is unmasked in place once. Fragmented messages are reassembled
+// and control frames interleaved with the fragments are returned on their
+// own.
+class WebSocketFrameParser {
+ public:
+  enum State {
+    STATE_HEADER,
+    STATE_PAYLOAD,
+    STATE_COMPLETE,
+    STATE_ERROR,
+  };
+
+  enum Opcode {
+    OPCODE_CONTINUATION = 0x0,
+    OPCODE_TEXT = 0x1,
+    OPCODE_BINARY = 0x2,
+    OPCODE_CLOSE = 0x8,
+    OPCODE_PING = 0x9,
+    OPCODE_PONG = 0xa,
+  };
+
+  WebSocketFrameParser();
+
+  // Consumes bytes up to the end of the current message or control frame
+  // and returns how many were used.
+  size_t Parse(const char* data, size_t len);
+  // Forgets the complete message, to be called once it has been handled.
+  void Reset();
+
+  State state() const { return state_; }
+  bool complete() const { return state_ == STATE_COMPLETE; }
+  bool error() const { return state_ == STATE_ERROR; }
+
+  Opcode opcode() const { return opcode_; }
+  const std::string& payload() const { return payload_; }
+
+  // Unmasked frame as sent by the server.
+  static std::string EncodeFrame(Opcode opcode, const std::string& payload);
+  // Value of the Sec-WebSocket-Accept header for a Sec-WebSocket-Key.
+  static std::string ComputeAcceptKey(const std::string& key);
+
+ protected:
+  bool ParseHeader();
+
+  State state_;
+  // Header bytes of the current frame, at most 14.
+  std::string header_;
+  bool fin_;
+  Opcode frame_opcode_;
+  uint8_t mask_[4];
+  uint64_t frame_length_;
+  uint64_t frame_read_;
+  // Opcode of the fragmented message being reassembled, if any.
+  Opcode message_opcode_;
+  std::string fragments_;
+  Opcode opcode_;
+  std::string payload_;
+};
+
+#endif  // PEERCONNECTION_WEBSOCKET_FRAME_PARSER_H_